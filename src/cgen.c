@@ -46,6 +46,8 @@ typedef struct {
    size_t             var_base;
    size_t             param_base;
    LLVMValueRef      *locals;
+   LLVMValueRef      *lines;
+   unsigned           n_lines;
 } cgen_ctx_t;
 
 typedef struct {
@@ -309,8 +311,14 @@ static LLVMValueRef cgen_get_var(vcode_var_t var, cgen_ctx_t *ctx)
 
 static LLVMValueRef cgen_tmp_alloc(LLVMValueRef bytes, LLVMTypeRef type)
 {
-   LLVMValueRef _tmp_stack_ptr = LLVMGetNamedGlobal(module, "_tmp_stack");
-   LLVMValueRef _tmp_alloc_ptr = LLVMGetNamedGlobal(module, "_tmp_alloc");
+   // The call is marked readnone so repeated allocations in the same
+   // function share one lookup of the per-thread state
+   LLVMValueRef tmp_state = LLVMBuildCall(builder, llvm_fn("_tmp_stack_ptr"),
+                                          NULL, 0, "tmp_state");
+   LLVMValueRef _tmp_stack_ptr =
+      LLVMBuildStructGEP(builder, tmp_state, 0, "tmp_stack_ptr");
+   LLVMValueRef _tmp_alloc_ptr =
+      LLVMBuildStructGEP(builder, tmp_state, 1, "tmp_alloc_ptr");
 
    LLVMValueRef alloc = LLVMBuildLoad(builder, _tmp_alloc_ptr, "alloc");
    LLVMValueRef stack = LLVMBuildLoad(builder, _tmp_stack_ptr, "stack");
@@ -1273,19 +1281,24 @@ static void cgen_op_param_upref(int op, cgen_ctx_t *ctx)
 
 static void cgen_op_resolved_address(int op, cgen_ctx_t *ctx)
 {
+   vcode_var_t shadow = vcode_get_address(op);
+   vcode_type_t type = vcode_var_type(shadow);
+
+   LLVMValueRef shadow_ptr = cgen_get_var(shadow, ctx);
+
+   // The kernel keeps a pointer to the shadow variable so it can be
+   // updated if the signal value buffers are swapped
    LLVMValueRef args[] = {
-      llvm_int32(vcode_signal_nets(vcode_get_signal(op))[0])
+      llvm_int32(vcode_signal_nets(vcode_get_signal(op))[0]),
+      llvm_void_cast(shadow_ptr)
    };
    LLVMValueRef res_mem = LLVMBuildCall(builder, llvm_fn("_resolved_address"),
                                         args, ARRAY_LEN(args), "");
 
-   vcode_var_t shadow = vcode_get_address(op);
-   vcode_type_t type = vcode_var_type(shadow);
-
    LLVMValueRef cast = LLVMBuildPointerCast(builder, res_mem,
                                             cgen_type(type), "");
 
-   LLVMBuildStore(builder, cast, cgen_get_var(shadow, ctx));
+   LLVMBuildStore(builder, cast, shadow_ptr);
 }
 
 static void cgen_op_nets(int op, cgen_ctx_t *ctx)
@@ -1329,7 +1342,8 @@ static void cgen_op_sched_waveform(int op, cgen_ctx_t *ctx)
       llvm_void_cast(valptr),
       cgen_get_arg(op, 1, ctx),
       cgen_get_arg(op, 4, ctx),
-      cgen_get_arg(op, 3, ctx)
+      cgen_get_arg(op, 3, ctx),
+      llvm_int32(vcode_get_subkind(op))
    };
    LLVMBuildCall(builder, llvm_fn("_sched_waveform"),
                  args, ARRAY_LEN(args), "");
@@ -1587,6 +1601,21 @@ static void cgen_op_record_ref(int op, cgen_ctx_t *ctx)
    }
 }
 
+static void cgen_op_sched_clock(int op, cgen_ctx_t *ctx)
+{
+   LLVMValueRef args[] = {
+      llvm_void_cast(cgen_get_arg(op, 0, ctx)),
+      llvm_void_cast(cgen_pointer_to_arg_data(op, 1, ctx)),
+      llvm_void_cast(cgen_pointer_to_arg_data(op, 2, ctx)),
+      cgen_get_arg(op, 3, ctx),
+      cgen_get_arg(op, 4, ctx),
+      cgen_get_arg(op, 5, ctx),
+      LLVMBuildZExt(builder, cgen_get_arg(op, 6, ctx), LLVMInt32Type(), ""),
+      llvm_int32(vcode_get_subkind(op))
+   };
+   LLVMBuildCall(builder, llvm_fn("_sched_clock"), args, ARRAY_LEN(args), "");
+}
+
 static void cgen_op_sched_event(int op, cgen_ctx_t *ctx)
 {
    LLVMValueRef args[] = {
@@ -2180,6 +2209,45 @@ static void cgen_op_index_check(int op, cgen_ctx_t *ctx)
    LLVMPositionBuilderAtEnd(builder, pass_bb);
 }
 
+static void cgen_op_debug_line(int op, cgen_ctx_t *ctx)
+{
+   // Start a new basic block for the statement and record its address
+   // so the runtime can map a sampled PC back to the source line
+
+   LLVMBasicBlockRef line_bb = LLVMAppendBasicBlock(ctx->fn, "line");
+   LLVMBuildBr(builder, line_bb);
+   LLVMPositionBuilderAtEnd(builder, line_bb);
+
+   ctx->lines = xrealloc(ctx->lines,
+                         (ctx->n_lines + 1) * 2 * sizeof(LLVMValueRef));
+
+   LLVMValueRef addr = LLVMBlockAddress(ctx->fn, line_bb);
+   ctx->lines[ctx->n_lines * 2] = LLVMConstPtrToInt(addr, LLVMInt64Type());
+   ctx->lines[ctx->n_lines * 2 + 1] = llvm_int64(vcode_get_value(op));
+   ctx->n_lines++;
+}
+
+static void cgen_line_table(cgen_ctx_t *ctx)
+{
+   // The table is the number of statements followed by the address of
+   // the code for each and its line number in the process source file
+
+   char *name LOCAL = xasprintf("%s__lines", istr(vcode_unit_name()));
+
+   const int nitems = ctx->n_lines * 2 + 1;
+   LLVMValueRef *init LOCAL = xmalloc(nitems * sizeof(LLVMValueRef));
+   init[0] = llvm_int64(ctx->n_lines);
+   for (int i = 1; i < nitems; i++)
+      init[i] = ctx->lines[i - 1];
+
+   LLVMTypeRef type = LLVMArrayType(LLVMInt64Type(), nitems);
+   LLVMValueRef table = LLVMAddGlobal(module, type, name);
+   LLVMSetGlobalConstant(table, true);
+   LLVMSetInitializer(table, LLVMConstArray(LLVMInt64Type(), init, nitems));
+
+   free(ctx->lines);
+}
+
 static void cgen_op_debug_out(int op, cgen_ctx_t *ctx)
 {
    LLVMValueRef arg0 = cgen_get_arg(op, 0, ctx);
@@ -2358,6 +2426,9 @@ static void cgen_op(int i, cgen_ctx_t *ctx)
    case VCODE_OP_SCHED_EVENT:
       cgen_op_sched_event(i, ctx);
       break;
+   case VCODE_OP_SCHED_CLOCK:
+      cgen_op_sched_clock(i, ctx);
+      break;
    case VCODE_OP_PCALL:
       cgen_op_pcall(i, false, ctx);
       break;
@@ -2445,6 +2516,9 @@ static void cgen_op(int i, cgen_ctx_t *ctx)
    case VCODE_OP_DEBUG_OUT:
       cgen_op_debug_out(i, ctx);
       break;
+   case VCODE_OP_DEBUG_LINE:
+      cgen_op_debug_line(i, ctx);
+      break;
    default:
       fatal("cannot generate code for vcode op %s", vcode_op_string(op));
    }
@@ -2619,6 +2693,96 @@ static void cgen_state_struct(cgen_ctx_t *ctx)
    LLVMSetInitializer(ctx->state, LLVMGetUndef(state_ty));
 }
 
+static bool cgen_is_plain(vcode_type_t type)
+{
+   // True if values of this type contain no pointers and so can be
+   // copied between processes
+
+   switch (vtype_kind(type)) {
+   case VCODE_TYPE_INT:
+   case VCODE_TYPE_REAL:
+   case VCODE_TYPE_OFFSET:
+      return true;
+
+   case VCODE_TYPE_CARRAY:
+      return cgen_is_plain(vtype_elem(type));
+
+   case VCODE_TYPE_RECORD:
+      {
+         const int nfields = vtype_fields(type);
+         for (int i = 0; i < nfields; i++) {
+            if (!cgen_is_plain(vtype_field(type, i)))
+               return false;
+         }
+         return true;
+      }
+
+   default:
+      return false;
+   }
+}
+
+static void cgen_checkpoint_entry(LLVMValueRef *entries, int *nentries,
+                                  LLVMValueRef ptr, bool plain)
+{
+   LLVMTypeRef type = LLVMGetElementType(LLVMTypeOf(ptr));
+   entries[(*nentries)++] = LLVMConstPtrToInt(ptr, LLVMInt64Type());
+   entries[(*nentries)++] = plain ? LLVMSizeOf(type) : llvm_int64(0);
+}
+
+static void cgen_checkpoint_table(LLVMValueRef *entries, int nentries)
+{
+   // The kernel saves and restores the mutable state of each unit
+   // through a table of the number of items followed by the address
+   // and size of each: a size of zero marks an item containing
+   // pointers which cannot be checkpointed
+
+   char *name LOCAL = xasprintf("%s__checkpoint", istr(vcode_unit_name()));
+
+   LLVMValueRef *init LOCAL = xmalloc((nentries + 1) * sizeof(LLVMValueRef));
+   init[0] = llvm_int64(nentries / 2);
+   for (int i = 0; i < nentries; i++)
+      init[i + 1] = entries[i];
+
+   LLVMTypeRef type = LLVMArrayType(LLVMInt64Type(), nentries + 1);
+   LLVMValueRef table = LLVMAddGlobal(module, type, name);
+   LLVMSetGlobalConstant(table, true);
+   LLVMSetInitializer(table,
+                      LLVMConstArray(LLVMInt64Type(), init, nentries + 1));
+}
+
+static void cgen_process_checkpoint(cgen_ctx_t *ctx)
+{
+   // Constants are recomputed when the process is reset so only the
+   // resume point, procedure state, and variables are saved
+
+   const int nvars = vcode_count_vars();
+   LLVMValueRef *entries LOCAL =
+      xmalloc((nvars + 2) * 2 * sizeof(LLVMValueRef));
+   int nentries = 0;
+
+   for (int i = 0; i < 2; i++) {
+      LLVMValueRef indexes[] = { llvm_int32(0), llvm_int32(i) };
+      LLVMValueRef ptr = LLVMConstInBoundsGEP(ctx->state, indexes, 2);
+      cgen_checkpoint_entry(entries, &nentries, ptr, true);
+   }
+
+   for (int i = 0; i < nvars; i++) {
+      vcode_var_t var = vcode_var_handle(i);
+      if (vcode_var_const(var))
+         continue;
+
+      LLVMValueRef indexes[] = {
+         llvm_int32(0), llvm_int32(ctx->var_base + i)
+      };
+      LLVMValueRef ptr = LLVMConstInBoundsGEP(ctx->state, indexes, 2);
+      cgen_checkpoint_entry(entries, &nentries, ptr,
+                            cgen_is_plain(vcode_var_type(var)));
+   }
+
+   cgen_checkpoint_table(entries, nentries);
+}
+
 static void cgen_jump_table(cgen_ctx_t *ctx)
 {
    assert(ctx->state != NULL);
@@ -2742,6 +2906,7 @@ static void cgen_process(vcode_unit_t code)
       .fn = fn
    };
    cgen_state_struct(&ctx);
+   cgen_process_checkpoint(&ctx);
    cgen_alloc_context(&ctx);
 
    // If the parameter is non-zero jump to the init block
@@ -2768,6 +2933,10 @@ static void cgen_process(vcode_unit_t code)
    cgen_jump_table(&ctx);
 
    cgen_code(&ctx);
+
+   if (ctx.n_lines > 0)
+      cgen_line_table(&ctx);
+
    cgen_free_context(&ctx);
 }
 
@@ -2851,6 +3020,29 @@ static void cgen_shared_variables(void)
    }
 }
 
+static void cgen_shared_checkpoint(void)
+{
+   const int nvars = vcode_count_vars();
+   LLVMValueRef *entries LOCAL =
+      xmalloc(MAX(nvars, 1) * 2 * sizeof(LLVMValueRef));
+   int nentries = 0;
+
+   for (int i = 0; i < nvars; i++) {
+      vcode_var_t var = vcode_var_handle(i);
+      if (vcode_var_const(var) || vcode_var_extern(var))
+         continue;
+
+      LLVMValueRef global =
+         LLVMGetNamedGlobal(module, istr(vcode_var_name(var)));
+      assert(global != NULL);
+
+      cgen_checkpoint_entry(entries, &nentries, global,
+                            cgen_is_plain(vcode_var_type(var)));
+   }
+
+   cgen_checkpoint_table(entries, nentries);
+}
+
 static void cgen_signals(void)
 {
    const int nsignals = vcode_count_signals();
@@ -2886,6 +3078,8 @@ static void cgen_top(tree_t t)
 
    cgen_coverage_state(t);
    cgen_shared_variables();
+   if (tree_kind(t) == T_ELAB)
+      cgen_shared_checkpoint();
    cgen_signals();
    cgen_reset_function();
    cgen_subprograms(t);
@@ -2929,12 +3123,28 @@ static LLVMValueRef cgen_support_fn(const char *name)
          llvm_void_ptr(),
          LLVMInt32Type(),
          LLVMInt64Type(),
-         LLVMInt64Type()
+         LLVMInt64Type(),
+         LLVMInt32Type()
       };
       fn = LLVMAddFunction(module, "_sched_waveform",
                            LLVMFunctionType(LLVMVoidType(),
                                             args, ARRAY_LEN(args), false));
    }
+   else if (strcmp(name, "_sched_clock") == 0) {
+      LLVMTypeRef args[] = {
+         llvm_void_ptr(),
+         llvm_void_ptr(),
+         llvm_void_ptr(),
+         LLVMInt64Type(),
+         LLVMInt64Type(),
+         LLVMInt64Type(),
+         LLVMInt32Type(),
+         LLVMInt32Type()
+      };
+      fn = LLVMAddFunction(module, "_sched_clock",
+                           LLVMFunctionType(LLVMVoidType(),
+                                            args, ARRAY_LEN(args), false));
+   }
    else if (strcmp(name, "_sched_event") == 0) {
       LLVMTypeRef args[] = {
          llvm_void_ptr(),
@@ -2970,7 +3180,8 @@ static LLVMValueRef cgen_support_fn(const char *name)
    }
    else if (strcmp(name, "_resolved_address") == 0) {
       LLVMTypeRef args[] = {
-         LLVMInt32Type()
+         LLVMInt32Type(),
+         llvm_void_ptr()
       };
       fn = LLVMAddFunction(module, "_resolved_address",
                            LLVMFunctionType(llvm_void_ptr(),
@@ -3232,6 +3443,21 @@ static LLVMValueRef cgen_support_fn(const char *name)
    else if (strcmp(name, "_std_standard_now") == 0)
       fn = LLVMAddFunction(module, "_std_standard_now",
                            LLVMFunctionType(LLVMInt64Type(), NULL, 0, false));
+   else if (strcmp(name, "_restoring") == 0)
+      fn = LLVMAddFunction(module, "_restoring",
+                           LLVMFunctionType(LLVMInt1Type(), NULL, 0, false));
+   else if (strcmp(name, "_tmp_stack_ptr") == 0) {
+      // Each runtime worker thread has its own temporary stack
+      LLVMTypeRef fields[] = {
+         llvm_void_ptr(),
+         LLVMInt32Type()
+      };
+      LLVMTypeRef state = LLVMStructType(fields, ARRAY_LEN(fields), false);
+      fn = LLVMAddFunction(module, "_tmp_stack_ptr",
+                           LLVMFunctionType(LLVMPointerType(state, 0),
+                                            NULL, 0, false));
+      LLVMAddFunctionAttr(fn, LLVMReadNoneAttribute);
+   }
 
    if (fn != NULL)
       LLVMAddFunctionAttr(fn, LLVMNoUnwindAttribute);
@@ -3255,17 +3481,6 @@ static void cgen_module_name(tree_t top)
    LLVMSetLinkage(mod_name, LLVMPrivateLinkage);
 }
 
-static void cgen_tmp_stack(void)
-{
-   LLVMValueRef _tmp_stack =
-      LLVMAddGlobal(module, llvm_void_ptr(), "_tmp_stack");
-   LLVMSetLinkage(_tmp_stack, LLVMExternalLinkage);
-
-   LLVMValueRef _tmp_alloc =
-      LLVMAddGlobal(module, LLVMInt32Type(), "_tmp_alloc");
-   LLVMSetLinkage(_tmp_alloc, LLVMExternalLinkage);
-}
-
 void cgen(tree_t top)
 {
    tree_kind_t kind = tree_kind(top);
@@ -3276,7 +3491,6 @@ void cgen(tree_t top)
    builder = LLVMCreateBuilder();
 
    cgen_module_name(top);
-   cgen_tmp_stack();
 
    cgen_top(top);
 
@@ -69,8 +69,13 @@ static ident_t foreign_i;
 static ident_t nested_i;
 static ident_t vcode_obj_i;
 static ident_t drives_all_i;
+static ident_t driver_proc_i;
+static ident_t driver_slot_i;
+static ident_t driver_count_i;
 static ident_t driver_init_i;
 static ident_t static_i;
+static ident_t clock_i;
+static ident_t edges_i;
 static ident_t never_waits_i;
 static ident_t mangled_i;
 static ident_t last_value_i;
@@ -81,6 +86,9 @@ static ident_t partial_map_i;
 static ident_t prot_field_i;
 
 static const char *verbose = NULL;
+static vcode_block_t reset_bb = VCODE_INVALID_BLOCK;
+static bool restorable = false;
+static bool line_table = false;
 
 static vcode_reg_t lower_expr(tree_t expr, expr_ctx_t ctx);
 static vcode_reg_t lower_reify_expr(tree_t expr);
@@ -2562,7 +2570,7 @@ static bool lower_signal_sequential_nets(tree_t decl)
    return (i == nnets) && (nnets > 0);
 }
 
-static void lower_sched_event(tree_t on, bool is_static)
+static void lower_sched_event(tree_t on, bool is_static, unsigned edges)
 {
    tree_kind_t expr_kind = tree_kind(on);
    if (expr_kind != T_REF && expr_kind != T_ARRAY_REF
@@ -2590,7 +2598,7 @@ static void lower_sched_event(tree_t on, bool is_static)
 
    tree_kind_t kind = tree_kind(decl);
    if (kind == T_ALIAS) {
-      lower_sched_event(tree_value(decl), is_static);
+      lower_sched_event(tree_value(decl), is_static, edges);
       return;
    }
    else if (kind != T_SIGNAL_DECL && kind != T_PORT_DECL) {
@@ -2648,7 +2656,8 @@ static void lower_sched_event(tree_t on, bool is_static)
 
    const int flags =
       (sequential ? SCHED_SEQUENTIAL : 0)
-      | (is_static ? SCHED_STATIC : 0);
+      | (is_static ? SCHED_STATIC : 0)
+      | (edges << SCHED_EDGE_SHIFT);
 
    emit_sched_event(nets, n_elems, flags);
 }
@@ -2662,15 +2671,19 @@ static void lower_wait(tree_t wait)
    if (is_static) {
       // This process is always sensitive to the same set of signals so
       // only call _sched_event once at startup
-      vcode_select_block(0);
+      vcode_select_block(reset_bb);
    }
 
+   const unsigned edges = tree_attr_int(wait, edges_i, 0);
+
    const int ntriggers = tree_triggers(wait);
    for (int i = 0; i < ntriggers; i++)
-      lower_sched_event(tree_trigger(wait, i), is_static);
+      lower_sched_event(tree_trigger(wait, i), is_static, edges);
 
-   if (is_static)
+   if (is_static) {
+      reset_bb = vcode_active_block();
       vcode_select_block(active_bb);
+   }
 
    const bool has_delay = tree_has_delay(wait);
    const bool has_value = tree_has_value(wait);
@@ -2727,7 +2740,7 @@ static void lower_wait(tree_t wait)
       if (!is_static) {
          const int ntriggers = tree_triggers(wait);
          for (int i = 0; i < ntriggers; i++)
-            lower_sched_event(tree_trigger(wait, i), is_static);
+            lower_sched_event(tree_trigger(wait, i), is_static, 0);
       }
 
       emit_wait(resume, timeout_reg);
@@ -2826,6 +2839,33 @@ static void lower_var_assign(tree_t stmt)
    }
 }
 
+static int lower_driver_slot(tree_t target)
+{
+   // Find the index of the active process in the driver list of the
+   // target signal as assigned by lower_driver_target
+   for (;;) {
+      switch (tree_kind(target)) {
+      case T_ARRAY_REF:
+      case T_ARRAY_SLICE:
+      case T_RECORD_REF:
+         target = tree_value(target);
+         break;
+
+      case T_REF:
+         {
+            tree_t decl = tree_ref(target);
+            if (tree_kind(decl) == T_SIGNAL_DECL)
+               return tree_attr_int(decl, driver_slot_i, VCODE_INVALID_SLOT);
+            else
+               return VCODE_INVALID_SLOT;
+         }
+
+      default:
+         return VCODE_INVALID_SLOT;
+      }
+   }
+}
+
 static void lower_signal_assign(tree_t stmt)
 {
    vcode_reg_t reject;
@@ -2842,13 +2882,19 @@ static void lower_signal_assign(tree_t stmt)
    const int nparts = aggregate ? tree_assocs(target) : 1;
 
    vcode_reg_t nets[nparts];
+   int slots[nparts];
    if (aggregate) {
       part_type = type_elem(target_type);
-      for (int i = 0; i < nparts; i++)
-         nets[i] = lower_expr(tree_value(tree_assoc(target, i)), EXPR_LVALUE);
+      for (int i = 0; i < nparts; i++) {
+         tree_t value = tree_value(tree_assoc(target, i));
+         nets[i]  = lower_expr(value, EXPR_LVALUE);
+         slots[i] = lower_driver_slot(value);
+      }
+   }
+   else {
+      nets[0]  = lower_expr(target, EXPR_LVALUE);
+      slots[0] = lower_driver_slot(target);
    }
-   else
-      nets[0] = lower_expr(target, EXPR_LVALUE);
 
    vcode_reg_t nets_raw[nparts];
    for (int i = 0; i < nparts; i++) {
@@ -2891,17 +2937,17 @@ static void lower_signal_assign(tree_t stmt)
             assert(i == 0);
             vcode_reg_t data_reg = lower_array_data(rhs);
             emit_sched_waveform(nets_raw[i], count_reg, data_reg,
-                                reject, after);
+                                reject, after, slots[i]);
          }
          else if (type_is_record(part_type)) {
             const int width = type_width(part_type);
             emit_sched_waveform(nets_raw[i], emit_const(vtype_offset(), width),
-                                rhs, reject, after);
+                                rhs, reject, after, slots[i]);
          }
          else {
             assert(i == 0 || vcode_reg_kind(rhs) == VCODE_TYPE_POINTER);
             emit_sched_waveform(nets_raw[i], emit_const(vtype_offset(), 1),
-                                rhs, reject, after);
+                                rhs, reject, after, slots[i]);
 
             if (i + 1 < nparts)
                rhs = emit_add(rhs, emit_const(vtype_offset(), 1));
@@ -3366,6 +3412,10 @@ static void lower_case(tree_t stmt, loop_stack_t *loops)
 
 static void lower_stmt(tree_t stmt, loop_stack_t *loops)
 {
+   if (line_table && vcode_unit_kind() == VCODE_UNIT_PROCESS
+       && !vcode_block_finished())
+      emit_debug_line(tree_loc(stmt)->first_line);
+
    switch (tree_kind(stmt)) {
    case T_ASSERT:
       lower_assert(stmt);
@@ -3506,6 +3556,21 @@ static void lower_var_decl(tree_t decl)
    if (!tree_has_value(decl))
       return;
 
+   vcode_block_t skip_bb = VCODE_INVALID_BLOCK;
+   if (restorable && vcode_unit_kind() == VCODE_UNIT_PROCESS
+       && tree_kind(decl) == T_VAR_DECL) {
+      // Process variables are overwritten from the checkpoint when the
+      // simulation is restored so do not compute the initial value
+      vcode_reg_t restoring_reg =
+         emit_fcall(ident_new("_restoring"), vtype_bool(), NULL, 0);
+
+      vcode_block_t init_bb = emit_block();
+      skip_bb = emit_block();
+      emit_cond(restoring_reg, skip_bb, init_bb);
+
+      vcode_select_block(init_bb);
+   }
+
    vcode_reg_t dest_reg  = VCODE_INVALID_REG;
    vcode_reg_t count_reg = VCODE_INVALID_REG;
    vcode_reg_t mem_reg   = VCODE_INVALID_REG;
@@ -3578,6 +3643,11 @@ static void lower_var_decl(tree_t decl)
    }
    else
       emit_store(value, var);
+
+   if (skip_bb != VCODE_INVALID_BLOCK) {
+      emit_jump(skip_bb);
+      vcode_select_block(skip_bb);
+   }
 }
 
 static void lower_signal_decl(tree_t decl)
@@ -4095,6 +4165,16 @@ static void lower_driver_target(tree_t expr, tree_t proc)
    if (all_length == driven_length)
       tree_add_attr_ptr(decl, drives_all_i, proc);
 
+   if (tree_attr_ptr(decl, driver_proc_i) != proc) {
+      // Processes allocate their drivers in elaboration order so the
+      // position of this process in the driver list is known statically
+      // unless other processes drive disjoint parts of the signal
+      const int slot = tree_attr_int(decl, driver_count_i, 0);
+      tree_add_attr_int(decl, driver_slot_i, slot);
+      tree_add_attr_int(decl, driver_count_i, slot + 1);
+      tree_add_attr_ptr(decl, driver_proc_i, proc);
+   }
+
    vcode_reg_t init_reg = VCODE_INVALID_REG;
    tree_t init = tree_attr_tree(decl, driver_init_i);
    if (init != NULL)
@@ -4137,6 +4217,141 @@ static void lower_driver_fn(tree_t t, void *_ctx)
    }
 }
 
+static void lower_clock(tree_t proc, tree_t target)
+{
+   // The kernel drives the target signal from a periodic timer so
+   // the process body never needs to run
+
+   vcode_reg_t nets = lower_expr(target, EXPR_LVALUE);
+
+   vcode_reg_t v0 = lower_reify_expr(
+      tree_attr_tree(proc, ident_new("clock_v0")));
+   vcode_reg_t v1 = lower_reify_expr(
+      tree_attr_tree(proc, ident_new("clock_v1")));
+
+   tree_t after_tree = tree_attr_tree(proc, ident_new("clock_after"));
+   vcode_reg_t after;
+   if (after_tree != NULL)
+      after = lower_expr(after_tree, EXPR_RVALUE);
+   else
+      after = emit_const(vtype_int(INT64_MIN, INT64_MAX), 0);
+
+   vcode_reg_t p0 = lower_expr(tree_attr_tree(proc, ident_new("clock_p0")),
+                               EXPR_RVALUE);
+   vcode_reg_t p1 = lower_expr(tree_attr_tree(proc, ident_new("clock_p1")),
+                               EXPR_RVALUE);
+
+   // Set if the next value is the complement of the effective value
+   // rather than alternating between the two
+   const bool is_toggle =
+      tree_attr_int(proc, ident_new("clock_toggle"), 0);
+   vcode_reg_t toggle = emit_const(vtype_bool(), is_toggle);
+
+   emit_sched_clock(lower_array_data(nets), v0, v1, after, p0, p1, toggle,
+                    lower_driver_slot(target));
+}
+
+static unsigned lower_edge_values(tree_t value, tree_t signal)
+{
+   // Returns a mask of the values the signal must have for the
+   // condition to be true or zero if this cannot be determined
+
+   if (tree_kind(value) != T_FCALL)
+      return 0;
+
+   tree_t decl = tree_ref(value);
+   const int nparams = tree_params(value);
+
+   ident_t builtin = tree_attr_str(decl, builtin_i);
+   if (builtin == NULL) {
+      // Positions of '1' and 'H' or '0' and 'L' in STD_ULOGIC
+      unsigned mask;
+      if (icmp(tree_ident(decl), "IEEE.STD_LOGIC_1164.RISING_EDGE"))
+         mask = (1 << 3) | (1 << 7);
+      else if (icmp(tree_ident(decl), "IEEE.STD_LOGIC_1164.FALLING_EDGE"))
+         mask = (1 << 2) | (1 << 6);
+      else
+         return 0;
+
+      tree_t p0 = tree_value(tree_param(value, 0));
+      if (nparams == 1 && tree_kind(p0) == T_REF && tree_ref(p0) == signal)
+         return mask;
+      else
+         return 0;
+   }
+   else if (nparams != 2)
+      return 0;
+
+   tree_t p0 = tree_value(tree_param(value, 0));
+   tree_t p1 = tree_value(tree_param(value, 1));
+
+   if (icmp(builtin, "and")) {
+      const unsigned m0 = lower_edge_values(p0, signal);
+      const unsigned m1 = lower_edge_values(p1, signal);
+      if (m0 == 0 || m1 == 0)
+         return m0 | m1;
+      else
+         return (m0 & m1) ?: m0;
+   }
+   else if (icmp(builtin, "eq")) {
+      if (tree_kind(p1) == T_REF && tree_ref(p1) == signal) {
+         tree_t tmp = p0;
+         p0 = p1;
+         p1 = tmp;
+      }
+
+      unsigned pos;
+      if (tree_kind(p0) == T_REF && tree_ref(p0) == signal
+          && folded_enum(p1, &pos) && pos < 16)
+         return 1 << pos;
+   }
+
+   return 0;
+}
+
+static void lower_edge_triggered(tree_t proc)
+{
+   // A process which is sensitive to a single signal and only does
+   // anything on a particular edge of it
+   //
+   //   process (clk) is
+   //   begin
+   //     if rising_edge(clk) then
+   //       ...
+   //     end if;
+   //   end process;
+   //
+   // need not be woken by the kernel on the other edge
+
+   if (tree_stmts(proc) != 2)
+      return;
+
+   tree_t s0 = tree_stmt(proc, 0);
+   tree_t wait = tree_stmt(proc, 1);
+
+   if (tree_kind(s0) != T_IF || tree_else_stmts(s0) > 0)
+      return;
+   else if (tree_kind(wait) != T_WAIT || !tree_attr_int(wait, static_i, 0))
+      return;
+   else if (tree_triggers(wait) != 1)
+      return;
+
+   tree_t trigger = tree_trigger(wait, 0);
+   if (tree_kind(trigger) != T_REF)
+      return;
+
+   tree_t signal = tree_ref(trigger);
+   if (tree_kind(signal) != T_SIGNAL_DECL)
+      return;
+
+   if (!type_is_enum(tree_type(signal)))
+      return;
+
+   const unsigned edges = lower_edge_values(tree_value(s0), signal);
+   if (edges != 0)
+      tree_add_attr_int(wait, edges_i, edges);
+}
+
 static void lower_process(tree_t proc, vcode_unit_t context)
 {
    vcode_unit_t vu = emit_process(tree_ident(proc), context);
@@ -4144,20 +4359,35 @@ static void lower_process(tree_t proc, vcode_unit_t context)
    lower_decls(proc);
    tree_visit(proc, lower_driver_fn, proc);
 
+   // Initialising variables may have moved the end of the reset code
+   // out of block zero
+   reset_bb = vcode_active_block();
+
    lower_subprograms(proc, vu);
    vcode_select_unit(vu);
 
    vcode_block_t start_bb = emit_block();
    vcode_select_block(start_bb);
 
-   const int nstmts = tree_stmts(proc);
-   for (int i = 0; i < nstmts; i++)
-      lower_stmt(tree_stmt(proc, i), NULL);
+   tree_t clock = tree_attr_tree(proc, clock_i);
+   if (clock != NULL)
+      emit_wait(start_bb, VCODE_INVALID_REG);
+   else {
+      lower_edge_triggered(proc);
 
-   if (!vcode_block_finished())
-      emit_jump(start_bb);
+      const int nstmts = tree_stmts(proc);
+      for (int i = 0; i < nstmts; i++)
+         lower_stmt(tree_stmt(proc, i), NULL);
+
+      if (!vcode_block_finished())
+         emit_jump(start_bb);
+   }
+
+   vcode_select_block(reset_bb);
+
+   if (clock != NULL)
+      lower_clock(proc, clock);
 
-   vcode_select_block(0);
    emit_return(VCODE_INVALID_REG);
 
    lower_finished();
@@ -4225,8 +4455,13 @@ void lower_unit(tree_t unit)
    vcode_obj_i    = ident_new("vcode_obj");
    nested_i       = ident_new("nested");
    drives_all_i   = ident_new("drives_all");
+   driver_proc_i  = ident_new("driver_proc");
+   driver_slot_i  = ident_new("driver_slot");
+   driver_count_i = ident_new("driver_count");
    driver_init_i  = ident_new("driver_init");
    static_i       = ident_new("static");
+   clock_i        = ident_new("clock");
+   edges_i        = ident_new("edges");
    never_waits_i  = ident_new("never_waits");
    mangled_i      = ident_new("mangled");
    last_value_i   = ident_new("last_value");
@@ -4242,6 +4477,9 @@ void lower_unit(tree_t unit)
    else
       verbose = opt_get_str("dump-vcode");
 
+   line_table = opt_get_int("line-table");
+   restorable = opt_get_int("restorable");
+
    switch (tree_kind(unit)) {
    case T_ELAB:
       lower_elab(unit);
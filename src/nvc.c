@@ -22,9 +22,15 @@
 
 #include <unistd.h>
 #include <getopt.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <errno.h>
 #include <assert.h>
 #if defined HAVE_TCL_TCL_H
 #include <tcl/tcl.h>
@@ -203,6 +209,7 @@ static int elaborate(int argc, char **argv)
       { "dump-vcode",  optional_argument, 0, 'V' },
       { "native",      no_argument,       0, 'n' },
       { "cover",       no_argument,       0, 'c' },
+      { "line-table",  no_argument,       0, 'l' },
       { "verbose",     no_argument,       0, 'v' },
       { 0, 0, 0, 0 }
    };
@@ -228,6 +235,9 @@ static int elaborate(int argc, char **argv)
       case 'c':
          opt_set_int("cover", 1);
          break;
+      case 'l':
+         opt_set_int("line-table", 1);
+         break;
       case 'v':
          verbose = true;
          break;
@@ -373,6 +383,292 @@ static rt_severity_t parse_severity(const char *str)
       fatal("invalid severity level: %s", str);
 }
 
+static eventq_kind_t parse_event_queue(const char *str)
+{
+   if (strcmp(str, "heap") == 0)
+      return EVENTQ_HEAP;
+   else if (strcmp(str, "wheel") == 0)
+      return EVENTQ_WHEEL;
+   else
+      fatal("invalid event queue: %s (allowed are heap and wheel)", str);
+}
+
+typedef struct {
+   char          *name;
+   uint64_t       stop_time;
+   int            severity;
+   char          *plugins;
+} fork_test_t;
+
+static fork_test_t *parse_fork_tests(const char *file, uint64_t stop_time,
+                                     int *ntests)
+{
+   // Each line names a test followed by the run options that differ
+   // from the parent's
+
+   FILE *f = fopen(file, "r");
+   if (f == NULL)
+      fatal_errno("failed to open %s", file);
+
+   fork_test_t *tests = NULL;
+   int count = 0, alloc = 0;
+
+   char *line = NULL;
+   size_t linesz = 0;
+   while (getline(&line, &linesz, f) != -1) {
+      char *comment = strchr(line, '#');
+      if (comment != NULL)
+         *comment = '\0';
+
+      char *tok = strtok(line, " \t\r\n");
+      if (tok == NULL)
+         continue;
+
+      if (count == alloc) {
+         alloc = MAX(alloc * 2, 16);
+         tests = xrealloc(tests, alloc * sizeof(fork_test_t));
+      }
+
+      fork_test_t *t = &(tests[count++]);
+      t->name      = strdup(tok);
+      t->stop_time = stop_time;
+      t->severity  = -1;
+      t->plugins   = NULL;
+
+      while ((tok = strtok(NULL, " \t\r\n")) != NULL) {
+         if (strncmp(tok, "--stop-time=", 12) == 0)
+            t->stop_time = parse_time(tok + 12);
+         else if (strncmp(tok, "--exit-severity=", 16) == 0)
+            t->severity = parse_severity(tok + 16);
+#if ENABLE_VHPI
+         else if (strncmp(tok, "--load=", 7) == 0)
+            t->plugins = strdup(tok + 7);
+#endif
+         else
+            fatal("invalid option %s for test %s in %s", tok, t->name, file);
+      }
+   }
+
+   free(line);
+   fclose(f);
+
+   if (count == 0)
+      fatal("no tests listed in %s", file);
+
+   *ntests = count;
+   return tests;
+}
+
+static int fork_stats_fd = -1;
+
+static void fork_test_exit(void)
+{
+   // Registered with atexit in each child so the statistics are also
+   // sent when a test ends with a fatal error or failed assertion
+
+   if (fork_stats_fd == -1)
+      return;
+
+   rt_stats_t stats;
+   rt_get_stats(&stats);
+   if (write(fork_stats_fd, &stats, sizeof(stats)) != sizeof(stats))
+      warnf("failed to send statistics to parent");
+   close(fork_stats_fd);
+   fork_stats_fd = -1;
+}
+
+static pid_t fork_test_start(tree_t top, const fork_test_t *test, int *fd)
+{
+   int fds[2];
+   if (pipe(fds) != 0)
+      fatal_errno("pipe");
+
+   notef("running test %s", test->name);
+
+   const pid_t pid = rt_fork();
+   if (pid == 0) {
+      close(fds[0]);
+
+      fork_stats_fd = fds[1];
+      atexit(fork_test_exit);
+
+      // The parent prints the statistics for every test together
+      opt_set_int("rt-stats", RT_STATS_NONE);
+
+      // Each test writes its samples to a separate file
+      const char *sample_fname = opt_get_str("rt-sample-file");
+      if (sample_fname != NULL) {
+         char *tmp LOCAL = xasprintf("%s.%s", sample_fname, test->name);
+         opt_set_str("rt-sample-file", tmp);
+      }
+
+      if (test->severity != -1)
+         rt_set_exit_severity(test->severity);
+
+      if (test->plugins != NULL)
+         vhpi_load_plugins(top, test->plugins);
+
+      rt_run_sim(test->stop_time);
+      rt_end_of_tool(top);
+      exit(EXIT_SUCCESS);
+   }
+
+   close(fds[1]);
+   *fd = fds[0];
+   return pid;
+}
+
+static void fork_stats_json(const fork_test_t *tests, int ntests,
+                            const rt_stats_t *stats, const int *status,
+                            const struct rusage *usage)
+{
+   printf("[");
+   for (int i = 0; i < ntests; i++) {
+      const rt_stats_t *s = &(stats[i]);
+      const struct timeval *ut = &(usage[i].ru_utime);
+      const struct timeval *st = &(usage[i].ru_stime);
+      const long cpu_ms = (ut->tv_sec + st->tv_sec) * 1000
+         + (ut->tv_usec + st->tv_usec) / 1000;
+
+      printf("%s\n  { \"test\": \"%s\", \"status\": %d, \"signal\": %d,\n",
+             i > 0 ? "," : "", tests[i].name,
+             WIFEXITED(status[i]) ? WEXITSTATUS(status[i]) : -1,
+             WIFSIGNALED(status[i]) ? WTERMSIG(status[i]) : 0);
+      printf("    \"cpu_ms\": %ld, \"maxrss_kb\": %ld, \"now_fs\": %"PRIu64
+             ",\n", cpu_ms, usage[i].ru_maxrss, s->now);
+      printf("    \"cycles\": %"PRIu64", \"time_steps\": %"PRIu64
+             ", \"delta_cycles\": %"PRIu64", \"max_deltas\": %d,\n"
+             "    \"collapsed_deltas\": %"PRIu64",\n", s->cycles,
+             s->time_steps, s->cycles - s->time_steps, s->max_deltas,
+             s->collapsed);
+      printf("    \"events\": { \"executed\": %"PRIu64", \"cancelled\": "
+             "%"PRIu64", \"stale\": %"PRIu64", \"timeout\": %"PRIu64
+             ", \"driver\": %"PRIu64", \"transaction\": %"PRIu64
+             ", \"process\": %"PRIu64" },\n", s->events, s->cancelled,
+             s->stale, s->timeouts, s->drivers, s->transactions, s->wakeups);
+      printf("    \"event_queue_peak\": %"PRIu64",\n", s->eventq_peak);
+      printf("    \"resolution\": { \"calls\": %"PRIu64", \"ns\": %"PRIu64
+             " },\n", s->res_calls, s->res_ns);
+      printf("    \"vec_load\": { \"copy\": %"PRIu64", \"zero_copy\": "
+             "%"PRIu64" } }", s->vec_copy, s->vec_zero_copy);
+   }
+   printf("\n]\n");
+}
+
+static void fork_stats_text(const fork_test_t *tests, int ntests,
+                            const rt_stats_t *stats)
+{
+   for (int i = 0; i < ntests; i++) {
+      const rt_stats_t *s = &(stats[i]);
+      notef("%s: events executed:%"PRIu64" cancelled:%"PRIu64" stale:%"
+            PRIu64" event queue peak:%"PRIu64, tests[i].name, s->events,
+            s->cancelled, s->stale, s->eventq_peak);
+      notef("%s: events timeout:%"PRIu64" driver:%"PRIu64" transaction:%"
+            PRIu64" process:%"PRIu64, tests[i].name, s->timeouts,
+            s->drivers, s->transactions, s->wakeups);
+      notef("%s: time steps:%"PRIu64" delta cycles:%"PRIu64" max deltas:%d"
+            " collapsed delta cycles:%"PRIu64, tests[i].name, s->time_steps,
+            s->cycles - s->time_steps, s->max_deltas, s->collapsed);
+      notef("%s: resolution calls:%"PRIu64" time:%"PRIu64"ms vector loads "
+            "copy:%"PRIu64" zero copy:%"PRIu64, tests[i].name, s->res_calls,
+            s->res_ns / 1000000, s->vec_copy, s->vec_zero_copy);
+   }
+}
+
+static int run_fork_tests(tree_t top, fork_test_t *tests, int ntests,
+                          int jobs)
+{
+   // Each test runs in a child forked after initialisation so they all
+   // share the initialised design through copy-on-write. Up to jobs
+   // children run at once and are reaped in the order they finish
+
+   int nfailed = 0;
+   rt_stats_t *stats = xcalloc(ntests * sizeof(rt_stats_t));
+   int *status = xmalloc(ntests * sizeof(int));
+   struct rusage *usage = xcalloc(ntests * sizeof(struct rusage));
+   pid_t *pids = xmalloc(ntests * sizeof(pid_t));
+   int *fds = xmalloc(ntests * sizeof(int));
+
+   int next = 0, running = 0;
+   while (next < ntests || running > 0) {
+      if (next < ntests && running < jobs) {
+         pids[next] = fork_test_start(top, &(tests[next]), &(fds[next]));
+         next++;
+         running++;
+         continue;
+      }
+
+      int wstatus;
+      struct rusage ru;
+      const pid_t pid = wait4(-1, &wstatus, 0, &ru);
+      if (pid == -1 && errno == EINTR)
+         continue;
+      else if (pid == -1)
+         fatal_errno("wait4");
+
+      int i = 0;
+      while (i < next && pids[i] != pid)
+         i++;
+      if (i == next)
+         continue;   // Not one of the tests
+
+      running--;
+      pids[i]   = 0;
+      status[i] = wstatus;
+      usage[i]  = ru;
+
+      // Statistics are missing if the child was killed by a signal
+      if (read(fds[i], &(stats[i]), sizeof(rt_stats_t)) != sizeof(rt_stats_t))
+         memset(&(stats[i]), '\0', sizeof(rt_stats_t));
+      close(fds[i]);
+
+      if (!WIFEXITED(wstatus) || (WEXITSTATUS(wstatus) != EXIT_SUCCESS))
+         nfailed++;
+   }
+
+   if (opt_get_int("rt-stats") == RT_STATS_JSON)
+      fork_stats_json(tests, ntests, stats, status, usage);
+   else {
+      printf("\n%-24s %-8s %14s %12s %12s %12s %9s %10s\n", "test",
+             "status", "time", "events", "cycles", "deltas", "cpu ms",
+             "maxrss kB");
+
+      for (int i = 0; i < ntests; i++) {
+         char result[16];
+         if (WIFEXITED(status[i]))
+            checked_sprintf(result, sizeof(result), "%s",
+                            WEXITSTATUS(status[i]) ? "failed" : "passed");
+         else
+            checked_sprintf(result, sizeof(result), "signal %d",
+                            WTERMSIG(status[i]));
+
+         const struct timeval *ut = &(usage[i].ru_utime);
+         const struct timeval *st = &(usage[i].ru_stime);
+         const long cpu_ms = (ut->tv_sec + st->tv_sec) * 1000
+            + (ut->tv_usec + st->tv_usec) / 1000;
+
+         printf("%-24s %-8s %14s %12"PRIu64" %12"PRIu64" %12"PRIu64
+                " %9ld %10ld\n", tests[i].name, result,
+                fmt_time(stats[i].now), stats[i].events, stats[i].cycles,
+                stats[i].cycles - stats[i].time_steps, cpu_ms,
+                usage[i].ru_maxrss);
+      }
+
+      printf("%d of %d tests passed\n", ntests - nfailed, ntests);
+
+      if (opt_get_int("rt-stats") == RT_STATS_TEXT)
+         fork_stats_text(tests, ntests, stats);
+   }
+
+   free(stats);
+   free(status);
+   free(usage);
+   free(pids);
+   free(fds);
+
+   return nfailed > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
 static int run(int argc, char **argv)
 {
    set_work_lib();
@@ -382,13 +678,27 @@ static int run(int argc, char **argv)
       { "batch",         no_argument,       0, 'b' },
       { "command",       no_argument,       0, 'c' },
       { "stop-time",     required_argument, 0, 's' },
-      { "stats",         no_argument,       0, 'S' },
+      { "stats",         optional_argument, 0, 'S' },
       { "wave",          optional_argument, 0, 'w' },
       { "stop-delta",    required_argument, 0, 'd' },
       { "format",        required_argument, 0, 'f' },
       { "include",       required_argument, 0, 'i' },
       { "exclude",       required_argument, 0, 'e' },
       { "exit-severity", required_argument, 0, 'x' },
+      { "threads",       required_argument, 0, 'T' },
+      { "event-queue",   required_argument, 0, 'Q' },
+      { "levelise",      no_argument,       0, 'L' },
+      { "checkpoint-at", required_argument, 0, 'K' },
+      { "save",          required_argument, 0, 'V' },
+      { "restore",       required_argument, 0, 'R' },
+      { "fork-tests",    required_argument, 0, 'F' },
+      { "jobs",          required_argument, 0, 'j' },
+      { "profile",       optional_argument, 0, 'P' },
+      { "activity",      required_argument, 0, 'A' },
+      { "trace-file",    required_argument, 0, 'B' },
+      { "trace-records", required_argument, 0, 'N' },
+      { "sample",        optional_argument, 0, 'Y' },
+      { "perf-map",      no_argument,       0, 'J' },
 #if ENABLE_VHPI
       { "load",          required_argument, 0, 'l' },
 #endif
@@ -401,6 +711,13 @@ static int run(int argc, char **argv)
    uint64_t stop_time = UINT64_MAX;
    const char *wave_fname = NULL;
    const char *vhpi_plugins = NULL;
+   uint64_t checkpoint_at = UINT64_MAX;
+   const char *save_fname = NULL;
+   const char *restore_fname = NULL;
+   const char *fork_tests = NULL;
+   int jobs = sysconf(_SC_NPROCESSORS_ONLN);
+   const char *profile_fname = NULL;
+   const char *sample_fname = NULL;
 
    int c, index = 0;
    const char *spec = "bcw::l:";
@@ -435,7 +752,12 @@ static int run(int argc, char **argv)
             fatal("invalid waveform format: %s", optarg);
          break;
       case 'S':
-         opt_set_int("rt-stats", 1);
+         if (optarg == NULL)
+            opt_set_int("rt-stats", RT_STATS_TEXT);
+         else if (strcmp(optarg, "json") == 0)
+            opt_set_int("rt-stats", RT_STATS_JSON);
+         else
+            fatal("invalid statistics format: %s", optarg);
          break;
       case 'w':
          if (optarg == NULL)
@@ -458,6 +780,55 @@ static int run(int argc, char **argv)
       case 'x':
          rt_set_exit_severity(parse_severity(optarg));
          break;
+      case 'T':
+         opt_set_int("rt-threads", parse_int(optarg));
+         break;
+      case 'Q':
+         opt_set_int("rt-event-queue", parse_event_queue(optarg));
+         break;
+      case 'L':
+         opt_set_int("rt-levelise", 1);
+         break;
+      case 'K':
+         checkpoint_at = parse_time(optarg);
+         break;
+      case 'V':
+         save_fname = optarg;
+         break;
+      case 'R':
+         restore_fname = optarg;
+         break;
+      case 'F':
+         fork_tests = optarg;
+         break;
+      case 'j':
+         if ((jobs = parse_int(optarg)) <= 0)
+            fatal("invalid number of jobs: %s", optarg);
+         break;
+      case 'P':
+         opt_set_int("rt-profile", 1);
+         profile_fname = optarg ?: "";
+         break;
+      case 'A':
+         opt_set_str("rt-activity-file", optarg);
+         break;
+      case 'B':
+         opt_set_str("rt-trace-file", optarg);
+         break;
+      case 'N':
+         {
+            const int records = parse_int(optarg);
+            if (records <= 0)
+               fatal("invalid trace record count: %s", optarg);
+            opt_set_int("rt-trace-records", records);
+         }
+         break;
+      case 'Y':
+         sample_fname = optarg ?: "";
+         break;
+      case 'J':
+         opt_set_int("rt-perf-map", 1);
+         break;
       default:
          abort();
       }
@@ -466,6 +837,12 @@ static int run(int argc, char **argv)
    if (optind == argc)
       fatal("missing top-level unit name");
 
+   if ((save_fname == NULL) != (checkpoint_at == UINT64_MAX))
+      fatal("--checkpoint-at and --save must be used together");
+
+   if (fork_tests != NULL && (mode == COMMAND || save_fname != NULL))
+      fatal("--fork-tests cannot be used with --command or --save");
+
    ident_t top = to_unit_name(argv[optind]);
    ident_t ename = ident_prefix(top, ident_new("elab"), '.');
    tree_rd_ctx_t ctx;
@@ -504,21 +881,58 @@ static int run(int argc, char **argv)
          free(tmp);
    }
 
+   char *profile_tmp = NULL;
+   if (profile_fname != NULL) {
+      if (*profile_fname == '\0')
+         profile_fname = profile_tmp = xasprintf("%s.profile.json",
+                                                 argv[optind]);
+      opt_set_str("rt-profile-file", profile_fname);
+   }
+
+   char *sample_tmp = NULL;
+   if (sample_fname != NULL) {
+      if (*sample_fname == '\0')
+         sample_fname = sample_tmp = xasprintf("%s.folded", argv[optind]);
+      opt_set_str("rt-sample-file", sample_fname);
+   }
+
    rt_start_of_tool(e, ctx);
 
    if (vhpi_plugins != NULL)
       vhpi_load_plugins(e, vhpi_plugins);
 
-   rt_restart(e);
+   if (restore_fname != NULL)
+      rt_restore(e, restore_fname);
+   else
+      rt_restart(e);
+
+   if (save_fname != NULL)
+      rt_set_checkpoint(e, checkpoint_at, save_fname);
 
-   if (mode == COMMAND)
+   int status = EXIT_SUCCESS;
+   if (fork_tests != NULL) {
+      int ntests;
+      fork_test_t *tests = parse_fork_tests(fork_tests, stop_time, &ntests);
+      status = run_fork_tests(e, tests, ntests, MAX(jobs, 1));
+
+      for (int i = 0; i < ntests; i++) {
+         free(tests[i].name);
+         free(tests[i].plugins);
+      }
+      free(tests);
+   }
+   else if (mode == COMMAND)
       shell_run(e, ctx);
    else
       rt_run_sim(stop_time);
 
-   rt_end_of_tool(e);
+   // Each forked test ran the end of simulation actions itself
+   if (fork_tests == NULL)
+      rt_end_of_tool(e);
    tree_read_end(ctx);
-   return EXIT_SUCCESS;
+   free(profile_tmp);
+   free(sample_tmp);
+   return status;
 }
 
 static int make_cmd(int argc, char **argv)
@@ -634,12 +1048,24 @@ static int dump_cmd(int argc, char **argv)
 static void set_default_opts(void)
 {
    opt_set_int("rt-stats", 0);
+   opt_set_int("rt-threads", 1);
+   opt_set_int("rt-event-queue", EVENTQ_HEAP);
+   opt_set_int("rt-levelise", 0);
+   opt_set_int("rt-profile", 0);
+   opt_set_str("rt-profile-file", NULL);
+   opt_set_str("rt-activity-file", NULL);
+   opt_set_str("rt-trace-file", NULL);
+   opt_set_int("rt-trace-records", 1 << 20);
+   opt_set_str("rt-sample-file", NULL);
+   opt_set_int("rt-perf-map", 0);
    opt_set_int("rt_trace_en", 0);
    opt_set_int("dump-llvm", 0);
    opt_set_int("optimise", 1);
    opt_set_int("native", 0);
    opt_set_int("bootstrap", 0);
    opt_set_int("cover", 0);
+   opt_set_int("line-table", 0);
+   opt_set_int("restorable", 1);
    opt_set_int("stop-delta", 1000);
    opt_set_int("unit-test", 0);
    opt_set_int("prefer-explicit", 0);
@@ -661,6 +1087,7 @@ static void usage(void)
           " --codegen UNIT\t\t\tGenerate native shared library for UNIT\n"
           " --dump [OPTION]... UNIT\tPrint out previously analysed UNIT\n"
           " --make [OPTION]... [UNIT]...\tGenerate makefile to rebuild UNITs\n"
+          " --trace-dump FILE\t\tPrint binary trace written by --trace-file\n"
           "\n"
           "Global options may be placed before COMMAND:\n"
           " -L PATH\t\tAdd PATH to library search paths\n"
@@ -678,23 +1105,38 @@ static void usage(void)
           "     --cover\t\tEnable code coverage reporting\n"
           "     --disable-opt\tDisable LLVM optimisations\n"
           "     --dump-llvm\tPrint generated LLVM IR\n"
+          "     --line-table\tRecord statement lines for --sample\n"
           "     --native\t\tGenerate native code shared library\n"
           " -v, --verbose\t\tPrint resource usage at each step\n"
           "\n"
           "Run options:\n"
+          "     --activity=FILE\tWrite signal activity counts to FILE\n"
           " -b, --batch\t\tRun in batch mode (default)\n"
           " -c, --command\t\tRun in TCL command line mode\n"
+          "     --checkpoint-at=T\tSave a checkpoint after time T with --save\n"
+          "     --event-queue=Q\tFuture event queue is one of heap or wheel\n"
           "     --exclude=GLOB\tExclude signals matching GLOB from wave dump\n"
           "     --exit-severity=S\tExit after asserion failure of severity S\n"
+          "     --fork-tests=LIST\tRun each test in LIST from one initialisation\n"
           "     --format=FMT\tWaveform format is one of lxt, fst, or vcd\n"
           "     --include=GLOB\tInclude signals matching GLOB in wave dump\n"
+          "     --jobs=N\t\tRun up to N tests from --fork-tests at once\n"
+          "     --levelise\t\tCollapse combinational delta cycles\n"
 #ifdef ENABLE_VHPI
           "     --load=PLUGIN\tLoad VHPI plugin at startup\n"
 #endif
-          "     --stats\t\tPrint statistics at end of run\n"
+          "     --perf-map\t\tWrite /tmp/perf-PID.map for JIT code\n"
+          "     --profile[=FILE]\tReport time spent in each process\n"
+          "     --restore=FILE\tResume from a checkpoint saved in FILE\n"
+          "     --sample[=FILE]\tSample CPU time by process and function\n"
+          "     --save=FILE\tWrite the checkpoint to FILE\n"
+          "     --stats[=json]\tPrint statistics at end of run\n"
           "     --stop-delta=N\tStop after N delta cycles (default %d)\n"
           "     --stop-time=T\tStop after simulation time T (e.g. 5ns)\n"
+          "     --threads=N\tRun processes on N worker threads\n"
           "     --trace\t\tTrace simulation events\n"
+          "     --trace-file=FILE\tRecord binary event trace in FILE\n"
+          "     --trace-records=N\tKeep the last N trace records\n"
           " -w, --wave=FILE\tWrite waveform data; file name is optional\n"
           "\n"
           "Dump options:\n"
@@ -780,6 +1222,7 @@ int main(int argc, char **argv)
       { "make",     no_argument,       0, 'm' },
       { "std",      required_argument, 0, 's' },
       { "messages", required_argument, 0, 'M' },
+      { "trace-dump", required_argument, 0, 'D' },
       { 0, 0, 0, 0 }
    };
 
@@ -810,6 +1253,9 @@ int main(int argc, char **argv)
       case 'M':
          set_message_style(parse_message_style(optarg));
          break;
+      case 'D':
+         rt_trace_dump(optarg);
+         exit(EXIT_SUCCESS);
       case 'a':
       case 'e':
       case 'd':
@@ -17,6 +17,8 @@
 
 #include "util.h"
 #include "phase.h"
+#include "common.h"
+#include "hash.h"
 
 #include <stdlib.h>
 #include <assert.h>
@@ -26,6 +28,16 @@ static ident_t elide_bounds_i;
 static ident_t range_var_i;
 static ident_t last_value_i;
 static ident_t builtin_i;
+static ident_t clock_i;
+static ident_t clock_v0_i;
+static ident_t clock_v1_i;
+static ident_t clock_after_i;
+static ident_t clock_p0_i;
+static ident_t clock_p1_i;
+static ident_t clock_toggle_i;
+static ident_t static_i;
+static ident_t level_i;
+static ident_t transaction_i;
 
 ////////////////////////////////////////////////////////////////////////////////
 // Delete processes that contain just a single wait statement
@@ -164,6 +176,426 @@ static void opt_tag_last_value(tree_t t)
    }
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Identify free running clock generators
+//
+//   clk <= not clk after 5 ns;
+//
+//   process is
+//   begin
+//     clk <= '0';
+//     wait for 5 ns;
+//     clk <= '1';
+//     wait for 5 ns;
+//   end process;
+//
+// The kernel can drive these directly from a periodic timer without
+// running the process for each edge. The two values, initial delay, and
+// the delay after each value are attached to the process as attributes.
+// For the "not S" forms the kernel must compute the next value from the
+// effective value of S as it may have been forced or deposited.
+//
+
+static bool opt_clock_delay(tree_t t)
+{
+   int64_t delay;
+   return folded_int(t, &delay) && delay > 0;
+}
+
+static bool opt_clock_value(tree_t t)
+{
+   int64_t ival;
+   unsigned pos;
+   return folded_int(t, &ival) || folded_enum(t, &pos);
+}
+
+static tree_t opt_clock_target(tree_t t)
+{
+   // A single waveform assigned to a whole scalar signal
+
+   if (tree_kind(t) != T_SIGNAL_ASSIGN || tree_waveforms(t) != 1)
+      return NULL;
+
+   tree_t target = tree_target(t);
+   if (tree_kind(target) != T_REF)
+      return NULL;
+
+   tree_t decl = tree_ref(target);
+   if (tree_kind(decl) != T_SIGNAL_DECL)
+      return NULL;
+
+   type_t type = tree_type(decl);
+   if (!type_is_scalar(type) || type_is_real(type))
+      return NULL;
+
+   return target;
+}
+
+static tree_t opt_clock_toggle(tree_t value, tree_t target)
+{
+   // Match "not S" where S is the target signal and return the reference
+   // to S
+
+   if (tree_kind(value) != T_FCALL || tree_params(value) != 1)
+      return NULL;
+
+   ident_t builtin = tree_attr_str(tree_ref(value), builtin_i);
+   if (builtin == NULL || !icmp(builtin, "not"))
+      return NULL;
+
+   tree_t arg = tree_value(tree_param(value, 0));
+   if (tree_kind(arg) != T_REF || tree_ref(arg) != tree_ref(target))
+      return NULL;
+
+   return arg;
+}
+
+static bool opt_clock_wait(tree_t t, tree_t target)
+{
+   // A wait with only a timeout if target is NULL or otherwise a wait
+   // sensitive to just the target signal
+
+   if (tree_kind(t) != T_WAIT || tree_has_value(t))
+      return false;
+   else if (target == NULL)
+      return tree_triggers(t) == 0 && tree_has_delay(t)
+         && opt_clock_delay(tree_delay(t));
+   else if (tree_has_delay(t) || tree_triggers(t) != 1)
+      return false;
+
+   tree_t trigger = tree_trigger(t, 0);
+   return tree_kind(trigger) == T_REF && tree_ref(trigger) == tree_ref(target);
+}
+
+static void opt_tag_clock(tree_t t)
+{
+   if (tree_decls(t) > 0 || tree_attr_int(t, ident_new("postponed"), 0))
+      return;
+
+   const int nstmts = tree_stmts(t);
+   if (nstmts != 2 && nstmts != 4)
+      return;
+
+   tree_t s0 = tree_stmt(t, 0);
+   tree_t target = opt_clock_target(s0);
+   if (target == NULL)
+      return;
+
+   tree_t w0 = tree_waveform(s0, 0);
+   tree_t value0 = tree_value(w0);
+   tree_t v0, v1, after = NULL, p0, p1;
+   bool toggle = false;
+
+   if (nstmts == 2) {
+      // Either "S <= not S after D; wait on S;" or
+      // "S <= not S; wait for D;"
+
+      if ((v1 = opt_clock_toggle(value0, target)) == NULL)
+         return;
+
+      // The next value depends on the effective value of the signal
+      // which only matches the driving value if it is unresolved
+      type_t type = tree_type(tree_ref(target));
+      if (type_kind(type) == T_SUBTYPE && type_has_resolution(type))
+         return;
+
+      tree_t w = tree_stmt(t, 1);
+      if (tree_has_delay(w0)) {
+         if (!opt_clock_delay(tree_delay(w0)) || !opt_clock_wait(w, target))
+            return;
+
+         after = p0 = p1 = tree_delay(w0);
+      }
+      else if (opt_clock_wait(w, NULL))
+         p0 = p1 = tree_delay(w);
+      else
+         return;
+
+      v0 = value0;
+      toggle = true;
+   }
+   else {
+      // "S <= A; wait for P0; S <= B; wait for P1;"
+
+      tree_t s1 = tree_stmt(t, 2);
+      tree_t wait0 = tree_stmt(t, 1);
+      tree_t wait1 = tree_stmt(t, 3);
+
+      tree_t target1 = opt_clock_target(s1);
+      if (target1 == NULL || tree_ref(target1) != tree_ref(target))
+         return;
+
+      tree_t w1 = tree_waveform(s1, 0);
+      if (tree_has_delay(w0) || tree_has_delay(w1))
+         return;
+
+      v0 = value0;
+      v1 = tree_value(w1);
+      if (!opt_clock_value(v0) || !opt_clock_value(v1))
+         return;
+
+      if (!opt_clock_wait(wait0, NULL) || !opt_clock_wait(wait1, NULL))
+         return;
+
+      p0 = tree_delay(wait0);
+      p1 = tree_delay(wait1);
+   }
+
+   tree_add_attr_tree(t, clock_i, target);
+   tree_add_attr_tree(t, clock_v0_i, v0);
+   tree_add_attr_tree(t, clock_v1_i, v1);
+   tree_add_attr_tree(t, clock_p0_i, p0);
+   tree_add_attr_tree(t, clock_p1_i, p1);
+   if (after != NULL)
+      tree_add_attr_tree(t, clock_after_i, after);
+   if (toggle)
+      tree_add_attr_int(t, clock_toggle_i, 1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Levelise combinational processes
+//
+// A process which is only sensitive to a static list of signals, makes
+// only zero delay assignments, and does not observe signal attributes
+// such as 'EVENT can be evaluated in topological order with the other
+// such processes that drive its inputs. Each process in an acyclic
+// chain is tagged with its depth which the kernel uses to collapse the
+// delta cycles between stages.
+//
+
+typedef struct {
+   tree_t    proc;
+   tree_t   *outputs;
+   unsigned  noutputs;
+   unsigned *succs;
+   unsigned  nsuccs;
+   unsigned  npreds;
+   unsigned  level;
+   bool      comb;
+   bool      event;
+   unsigned  nwaits;
+} comb_node_t;
+
+static tree_t opt_signal_target(tree_t t)
+{
+   for (;;) {
+      switch (tree_kind(t)) {
+      case T_ARRAY_REF:
+      case T_ARRAY_SLICE:
+      case T_RECORD_REF:
+         t = tree_value(t);
+         break;
+
+      case T_REF:
+         {
+            tree_t decl = tree_ref(t);
+            return (tree_kind(decl) == T_SIGNAL_DECL) ? decl : NULL;
+         }
+
+      default:
+         return NULL;
+      }
+   }
+}
+
+static bool opt_has_signal_ports(tree_t decl)
+{
+   const int nports = tree_ports(decl);
+   for (int i = 0; i < nports; i++) {
+      if (tree_class(tree_port(decl, i)) == C_SIGNAL)
+         return true;
+   }
+
+   return false;
+}
+
+static void opt_comb_visit_fn(tree_t t, void *ctx)
+{
+   comb_node_t *node = ctx;
+
+   switch (tree_kind(t)) {
+   case T_WAIT:
+      node->nwaits++;
+      break;
+
+   case T_PCALL:
+      // Procedures may wait or drive signals through parameters
+      node->comb = false;
+      if (opt_has_signal_ports(tree_ref(t)))
+         node->event = true;
+      break;
+
+   case T_FCALL:
+      {
+         tree_t decl = tree_ref(t);
+         ident_t builtin = tree_attr_str(decl, builtin_i);
+         if (builtin == NULL) {
+            // Functions like RISING_EDGE read attributes of signal
+            // parameters
+            if (opt_has_signal_ports(decl))
+               node->event = true;
+         }
+         else if (icmp(builtin, "event") || icmp(builtin, "active")
+                  || icmp(builtin, "last_value")
+                  || icmp(builtin, "last_event")
+                  || icmp(builtin, "last_active")
+                  || icmp(builtin, "transaction"))
+            node->event = true;
+      }
+      break;
+
+   case T_SIGNAL_ASSIGN:
+      {
+         const int nwaves = tree_waveforms(t);
+         for (int i = 0; i < nwaves; i++) {
+            tree_t w = tree_waveform(t, i);
+            int64_t delay;
+            if (tree_has_delay(w)
+                && !(folded_int(tree_delay(w), &delay) && delay == 0))
+               node->comb = false;
+         }
+
+         tree_t decl = opt_signal_target(tree_target(t));
+         if (decl == NULL || tree_attr_int(decl, last_value_i, 0))
+            node->comb = false;
+         else {
+            node->outputs = xrealloc(node->outputs, (node->noutputs + 1)
+                                     * sizeof(tree_t));
+            node->outputs[node->noutputs++] = decl;
+         }
+      }
+      break;
+
+   default:
+      break;
+   }
+}
+
+static void opt_observe_fn(tree_t t, void *ctx)
+{
+   hash_t *observed = ctx;
+
+   tree_t decl = tree_ref(t);
+   if (tree_kind(decl) == T_SIGNAL_DECL)
+      hash_put(observed, decl, decl);
+}
+
+static void opt_comb_classify(tree_t proc, comb_node_t *node)
+{
+   node->proc = proc;
+   node->comb = !tree_attr_int(proc, ident_new("postponed"), 0);
+
+   // The implicit process for S'TRANSACTION toggles its signal once
+   // for every transaction on S
+   node->event = tree_attr_int(proc, transaction_i, 0);
+
+   tree_visit(proc, opt_comb_visit_fn, node);
+
+   const int nstmts = tree_stmts(proc);
+   if (nstmts == 0) {
+      node->comb = false;
+      return;
+   }
+
+   tree_t wait = tree_stmt(proc, nstmts - 1);
+
+   if (node->event || node->nwaits != 1 || tree_kind(wait) != T_WAIT
+       || !tree_attr_int(wait, static_i, 0) || tree_triggers(wait) == 0)
+      node->comb = false;
+}
+
+static void opt_levelise(tree_t top)
+{
+   const int nstmts = tree_stmts(top);
+   comb_node_t *nodes = xcalloc(nstmts * sizeof(comb_node_t));
+
+   hash_t *observed = hash_new(256, true);
+
+   for (int i = 0; i < nstmts; i++) {
+      tree_t p = tree_stmt(top, i);
+      opt_comb_classify(p, &(nodes[i]));
+
+      // The timing of every signal a process reads is visible to it if
+      // the process looks at any signal attributes
+      if (nodes[i].event)
+         tree_visit_only(p, opt_observe_fn, observed, T_REF);
+   }
+
+   hash_t *drivers = hash_new(256, false);
+
+   for (int i = 0; i < nstmts; i++) {
+      comb_node_t *n = &(nodes[i]);
+      for (unsigned j = 0; n->comb && j < n->noutputs; j++) {
+         if (hash_get(observed, n->outputs[j]) != NULL)
+            n->comb = false;
+      }
+
+      for (unsigned j = 0; n->comb && j < n->noutputs; j++)
+         hash_put(drivers, n->outputs[j], n);
+   }
+
+   for (int i = 0; i < nstmts; i++) {
+      comb_node_t *n = &(nodes[i]);
+      if (!n->comb)
+         continue;
+
+      tree_t wait = tree_stmt(n->proc, tree_stmts(n->proc) - 1);
+
+      const int ntriggers = tree_triggers(wait);
+      for (int j = 0; j < ntriggers; j++) {
+         tree_t decl = opt_signal_target(tree_trigger(wait, j));
+         if (decl == NULL)
+            continue;
+
+         comb_node_t *pred;
+         int k = 0, tmp;
+         while ((tmp = k++),
+                (pred = hash_get_nth(drivers, decl, &tmp)) != NULL) {
+            pred->succs = xrealloc(pred->succs, (pred->nsuccs + 1)
+                                   * sizeof(unsigned));
+            pred->succs[pred->nsuccs++] = i;
+            n->npreds++;
+         }
+      }
+   }
+
+   // Assign levels in topological order: processes on a cycle, or
+   // downstream of one, never reach zero predecessors and keep normal
+   // delta cycle semantics
+
+   unsigned *queue = xmalloc(nstmts * sizeof(unsigned));
+   unsigned qhead = 0, qtail = 0;
+
+   for (int i = 0; i < nstmts; i++) {
+      if (nodes[i].comb && nodes[i].npreds == 0) {
+         nodes[i].level = 1;
+         queue[qtail++] = i;
+      }
+   }
+
+   while (qhead < qtail) {
+      comb_node_t *n = &(nodes[queue[qhead++]]);
+      tree_add_attr_int(n->proc, level_i, n->level);
+
+      for (unsigned j = 0; j < n->nsuccs; j++) {
+         comb_node_t *succ = &(nodes[n->succs[j]]);
+         succ->level = MAX(succ->level, n->level + 1);
+         if (--(succ->npreds) == 0)
+            queue[qtail++] = n->succs[j];
+      }
+   }
+
+   for (int i = 0; i < nstmts; i++) {
+      free(nodes[i].outputs);
+      free(nodes[i].succs);
+   }
+
+   free(queue);
+   free(nodes);
+   hash_free(observed);
+   hash_free(drivers);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 static void opt_tag(tree_t t, void *ctx)
@@ -194,9 +626,27 @@ void opt(tree_t top)
    range_var_i    = ident_new("range_var");
    builtin_i      = ident_new("builtin");
    last_value_i   = ident_new("last_value");
+   clock_i        = ident_new("clock");
+   clock_v0_i     = ident_new("clock_v0");
+   clock_v1_i     = ident_new("clock_v1");
+   clock_after_i  = ident_new("clock_after");
+   clock_p0_i     = ident_new("clock_p0");
+   clock_p1_i     = ident_new("clock_p1");
+   clock_toggle_i = ident_new("clock_toggle");
+   static_i       = ident_new("static");
+   level_i        = ident_new("level");
+   transaction_i  = ident_new("transaction");
 
    if (tree_kind(top) == T_ELAB)
       opt_delete_wait_only(top);
 
    tree_visit(top, opt_tag, NULL);
+
+   if (tree_kind(top) == T_ELAB && opt_get_int("optimise")) {
+      const int nstmts = tree_stmts(top);
+      for (int i = 0; i < nstmts; i++)
+         opt_tag_clock(tree_stmt(top, i));
+
+      opt_levelise(top);
+   }
 }
@@ -19,23 +19,39 @@
 
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 
 // Profiling shows a large proportion of simulation time is spent in
 // malloc and free. These routines provide a stack-based fixed-size
 // allocator that is faster and has better cache locality.
 
-#define INIT_ITEMS 128
+#define INIT_ITEMS  128
+#define CHUNK_ALIGN 4096
+#define CHUNK_BYTES (64 * 1024)
+
+// Buffers larger than the biggest size class are passed to malloc
+#define POOL_MIN_SHIFT 4
+#define POOL_MAX_SHIFT 16
+#define POOL_CLASSES   (POOL_MAX_SHIFT - POOL_MIN_SHIFT + 1)
 
 struct rt_chunk {
    void       *ptr;
    rt_chunk_t *next;
 };
 
+struct rt_pool {
+   const char       *name;
+   rt_alloc_stack_t  classes[POOL_CLASSES];
+   rt_pool_stats_t   stats[POOL_CLASSES + 1];
+};
+
 static void rt_alloc_add_objects(rt_alloc_stack_t s, size_t n)
 {
    rt_chunk_t *c = xmalloc(sizeof(rt_chunk_t));
    c->next = s->chunks;
-   c->ptr  = xmalloc(n * s->item_sz);
+
+   if (posix_memalign(&(c->ptr), CHUNK_ALIGN, n * s->item_sz) != 0)
+      fatal_errno("posix_memalign");
 
    char *p = c->ptr;
    for (int i = 0; i < n; i++, p += s->item_sz)
@@ -46,15 +62,19 @@ static void rt_alloc_add_objects(rt_alloc_stack_t s, size_t n)
 
 rt_alloc_stack_t rt_alloc_stack_new(size_t size, const char *name)
 {
+   // Start with fewer items if they are large
+   const size_t nitems = MAX(1, MIN(INIT_ITEMS, CHUNK_BYTES / size));
+
    struct rt_alloc_stack *s = xmalloc(sizeof(struct rt_alloc_stack));
-   s->stack     = xmalloc(sizeof(void *) * INIT_ITEMS);
-   s->stack_sz  = INIT_ITEMS;
+   s->stack     = xmalloc(sizeof(void *) * nitems);
+   s->stack_sz  = nitems;
    s->stack_top = 0;
    s->item_sz   = size;
+   s->peak      = 0;
    s->name      = name;
    s->chunks    = NULL;
 
-   rt_alloc_add_objects(s, INIT_ITEMS);
+   rt_alloc_add_objects(s, nitems);
 
    return s;
 }
@@ -85,5 +105,89 @@ void *rt_alloc_slow(rt_alloc_stack_t s)
       rt_alloc_add_objects(s, s->stack_sz / 2);
    }
 
-   return s->stack[--s->stack_top];
+   void *ptr = s->stack[--s->stack_top];
+
+   s->peak = MAX(s->peak, s->stack_sz - s->stack_top);
+
+   return ptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Size-classed pools for variable length buffers
+//
+// Each power-of-two size class is backed by its own allocation stack so
+// memory freed by one group can be reused by any other group whose
+// buffers fall into the same class.
+
+static int rt_pool_class(size_t size)
+{
+   int shift = POOL_MIN_SHIFT;
+   while ((shift <= POOL_MAX_SHIFT) && (((size_t)1 << shift) < size))
+      shift++;
+
+   return shift - POOL_MIN_SHIFT;
+}
+
+rt_pool_t rt_pool_new(const char *name)
+{
+   struct rt_pool *p = xmalloc(sizeof(struct rt_pool));
+   p->name = name;
+
+   memset(p->classes, '\0', sizeof(p->classes));
+   memset(p->stats, '\0', sizeof(p->stats));
+
+   for (int i = 0; i < POOL_CLASSES; i++)
+      p->stats[i].size = (size_t)1 << (i + POOL_MIN_SHIFT);
+
+   return p;
+}
+
+void rt_pool_destroy(rt_pool_t p)
+{
+   for (int i = 0; i < POOL_CLASSES; i++) {
+      if (p->classes[i] != NULL)
+         rt_alloc_stack_destroy(p->classes[i]);
+   }
+
+   free(p);
+}
+
+void *rt_pool_alloc(rt_pool_t p, size_t size)
+{
+   const int class = rt_pool_class(size);
+
+   rt_pool_stats_t *st = &(p->stats[class]);
+   st->allocs++;
+   st->peak = MAX(st->peak, ++(st->in_use));
+
+   if (class == POOL_CLASSES)
+      return xmalloc(size);
+
+   if (unlikely(p->classes[class] == NULL))
+      p->classes[class] = rt_alloc_stack_new(st->size, p->name);
+
+   return rt_alloc(p->classes[class]);
+}
+
+void rt_pool_free(rt_pool_t p, void *ptr, size_t size)
+{
+   if (ptr == NULL)
+      return;
+
+   const int class = rt_pool_class(size);
+
+   assert(p->stats[class].in_use > 0);
+   p->stats[class].in_use--;
+
+   if (class == POOL_CLASSES)
+      free(ptr);
+   else
+      rt_free(p->classes[class], ptr);
+}
+
+const rt_pool_stats_t *rt_pool_stats(rt_pool_t p, unsigned *nclasses)
+{
+   // The final entry counts buffers too large for any size class
+   *nclasses = POOL_CLASSES + 1;
+   return p->stats;
 }
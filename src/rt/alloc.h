@@ -21,6 +21,7 @@
 #include "util.h"
 
 #include <assert.h>
+#include <stdint.h>
 
 typedef struct rt_chunk rt_chunk_t;
 
@@ -29,22 +30,44 @@ struct rt_alloc_stack {
    size_t      stack_sz;
    size_t      stack_top;
    size_t      item_sz;
+   size_t      peak;
    const char *name;
    rt_chunk_t *chunks;
 };
 
 typedef struct rt_alloc_stack *rt_alloc_stack_t;
 
+typedef struct rt_pool *rt_pool_t;
+
+typedef struct {
+   size_t   size;
+   uint64_t allocs;
+   size_t   in_use;
+   size_t   peak;
+} rt_pool_stats_t;
+
 rt_alloc_stack_t rt_alloc_stack_new(size_t size, const char *name);
 void rt_alloc_stack_destroy(rt_alloc_stack_t stack);
 void *rt_alloc_slow(rt_alloc_stack_t stack);
 
+rt_pool_t rt_pool_new(const char *name);
+void rt_pool_destroy(rt_pool_t pool);
+void *rt_pool_alloc(rt_pool_t pool, size_t size);
+void rt_pool_free(rt_pool_t pool, void *ptr, size_t size);
+const rt_pool_stats_t *rt_pool_stats(rt_pool_t pool, unsigned *nclasses);
+
 static inline void *rt_alloc(rt_alloc_stack_t s)
 {
    if (unlikely(s->stack_top == 0))
       return rt_alloc_slow(s);
-   else
-      return s->stack[--s->stack_top];
+
+   void *ptr = s->stack[--s->stack_top];
+
+   const size_t in_use = s->stack_sz - s->stack_top;
+   if (unlikely(in_use > s->peak))
+      s->peak = in_use;
+
+   return ptr;
 }
 
 static inline void rt_free(rt_alloc_stack_t s, void *ptr)
@@ -0,0 +1,246 @@
+//
+//  Copyright (C) 2015  Nick Gasson
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "util.h"
+#include "itree.h"
+#include "alloc.h"
+
+#include <stdlib.h>
+
+// Interval tree implemented as a treap ordered on the low end of each
+// interval and augmented with the maximum high end in each subtree.
+// Intervals with the same low end are ordered by insertion so walking
+// or extracting visits entries in a deterministic order.
+
+struct inode {
+   uint32_t  low;
+   uint32_t  high;
+   uint32_t  max;
+   uint32_t  prio;
+   uint64_t  seq;
+   void     *user;
+   inode_t  *left;
+   inode_t  *right;
+};
+
+struct itree {
+   inode_t          *root;
+   size_t            size;
+   uint64_t          next_seq;
+   uint32_t          rand;
+   rt_alloc_stack_t  node_stack;
+};
+
+static inline bool itree_before(const inode_t *a, const inode_t *b)
+{
+   return (a->low < b->low) || ((a->low == b->low) && (a->seq < b->seq));
+}
+
+static inline void itree_update(inode_t *n)
+{
+   n->max = n->high;
+   if ((n->left != NULL) && (n->left->max > n->max))
+      n->max = n->left->max;
+   if ((n->right != NULL) && (n->right->max > n->max))
+      n->max = n->right->max;
+}
+
+static uint32_t itree_rand(itree_t t)
+{
+   // Xorshift generator gives the same tree shape on every run
+   t->rand ^= t->rand << 13;
+   t->rand ^= t->rand >> 17;
+   t->rand ^= t->rand << 5;
+   return t->rand;
+}
+
+static inode_t *itree_merge(inode_t *a, inode_t *b)
+{
+   // All entries in a are ordered before those in b
+   if (a == NULL)
+      return b;
+   else if (b == NULL)
+      return a;
+   else if (a->prio > b->prio) {
+      a->right = itree_merge(a->right, b);
+      itree_update(a);
+      return a;
+   }
+   else {
+      b->left = itree_merge(a, b->left);
+      itree_update(b);
+      return b;
+   }
+}
+
+static inode_t *itree_insert_node(inode_t *root, inode_t *n)
+{
+   if (root == NULL)
+      return n;
+   else if (itree_before(n, root)) {
+      root->left = itree_insert_node(root->left, n);
+      if (root->left->prio > root->prio) {
+         inode_t *l = root->left;
+         root->left = l->right;
+         l->right = root;
+         itree_update(root);
+         root = l;
+      }
+   }
+   else {
+      root->right = itree_insert_node(root->right, n);
+      if (root->right->prio > root->prio) {
+         inode_t *r = root->right;
+         root->right = r->left;
+         r->left = root;
+         itree_update(root);
+         root = r;
+      }
+   }
+
+   itree_update(root);
+   return root;
+}
+
+static inode_t *itree_remove_node(inode_t *root, inode_t *n)
+{
+   if (unlikely(root == NULL))
+      fatal_trace("interval %u..%u not in tree", n->low, n->high);
+   else if (root == n)
+      return itree_merge(n->left, n->right);
+   else if (itree_before(n, root))
+      root->left = itree_remove_node(root->left, n);
+   else
+      root->right = itree_remove_node(root->right, n);
+
+   itree_update(root);
+   return root;
+}
+
+static inode_t *itree_extract_node(itree_t t, inode_t *n, uint32_t low,
+                                   uint32_t high, itree_fn_t fn,
+                                   void *context)
+{
+   if ((n == NULL) || (n->max < low))
+      return n;
+
+   n->left = itree_extract_node(t, n->left, low, high, fn, context);
+
+   if (n->low > high) {
+      // Nothing in the right subtree can overlap either
+      itree_update(n);
+      return n;
+   }
+
+   const bool hit = (low <= n->high);
+   if (hit)
+      (*fn)(n->low, n->high, n->user, context);
+
+   n->right = itree_extract_node(t, n->right, low, high, fn, context);
+
+   if (hit) {
+      inode_t *merged = itree_merge(n->left, n->right);
+      rt_free(t->node_stack, n);
+      --(t->size);
+      return merged;
+   }
+   else {
+      itree_update(n);
+      return n;
+   }
+}
+
+static void itree_walk_node(inode_t *n, itree_fn_t fn, void *context)
+{
+   if (n != NULL) {
+      itree_walk_node(n->left, fn, context);
+      (*fn)(n->low, n->high, n->user, context);
+      itree_walk_node(n->right, fn, context);
+   }
+}
+
+static void itree_free_node(itree_t t, inode_t *n)
+{
+   if (n != NULL) {
+      itree_free_node(t, n->left);
+      itree_free_node(t, n->right);
+      rt_free(t->node_stack, n);
+   }
+}
+
+itree_t itree_new(void)
+{
+   struct itree *t = xmalloc(sizeof(struct itree));
+   t->root       = NULL;
+   t->size       = 0;
+   t->next_seq   = 0;
+   t->rand       = 0x9e3779b9;
+   t->node_stack = rt_alloc_stack_new(sizeof(inode_t), "itree");
+   return t;
+}
+
+void itree_free(itree_t t)
+{
+   itree_free_node(t, t->root);
+   rt_alloc_stack_destroy(t->node_stack);
+   free(t);
+}
+
+inode_t *itree_insert(itree_t t, uint32_t low, uint32_t high, void *user)
+{
+   assert(low <= high);
+
+   inode_t *n = rt_alloc(t->node_stack);
+   n->low   = low;
+   n->high  = high;
+   n->max   = high;
+   n->prio  = itree_rand(t);
+   n->seq   = (t->next_seq)++;
+   n->user  = user;
+   n->left  = NULL;
+   n->right = NULL;
+
+   t->root = itree_insert_node(t->root, n);
+   ++(t->size);
+
+   return n;
+}
+
+void itree_remove(itree_t t, inode_t *n)
+{
+   t->root = itree_remove_node(t->root, n);
+   rt_free(t->node_stack, n);
+   --(t->size);
+}
+
+void itree_extract(itree_t t, uint32_t low, uint32_t high,
+                   itree_fn_t fn, void *context)
+{
+   // Remove every interval overlapping low..high calling fn for each
+   // in order of increasing low end
+   t->root = itree_extract_node(t, t->root, low, high, fn, context);
+}
+
+size_t itree_size(itree_t t)
+{
+   return t->size;
+}
+
+void itree_walk(itree_t t, itree_fn_t fn, void *context)
+{
+   itree_walk_node(t->root, fn, context);
+}
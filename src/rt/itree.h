@@ -0,0 +1,40 @@
+//
+//  Copyright (C) 2015  Nick Gasson
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef _ITREE_H
+#define _ITREE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct itree *itree_t;
+typedef struct inode inode_t;
+
+typedef void (*itree_fn_t)(uint32_t low, uint32_t high, void *user,
+                           void *context);
+
+itree_t itree_new(void);
+void itree_free(itree_t t);
+inode_t *itree_insert(itree_t t, uint32_t low, uint32_t high, void *user);
+void itree_remove(itree_t t, inode_t *n);
+void itree_extract(itree_t t, uint32_t low, uint32_t high,
+                   itree_fn_t fn, void *context);
+size_t itree_size(itree_t t);
+void itree_walk(itree_t t, itree_fn_t fn, void *context);
+
+#endif  // _ITREE_H
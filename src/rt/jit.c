@@ -29,6 +29,10 @@
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef __GLIBC__
+#include <link.h>
+#endif
+
 #include <llvm-c/Core.h>
 #include <llvm-c/BitReader.h>
 #include <llvm-c/ExecutionEngine.h>
@@ -39,6 +43,26 @@ static LLVMExecutionEngineRef exec_engine = NULL;
 static bool using_jit = true;
 static void *dl_handle = NULL;
 
+#ifdef __GLIBC__
+// The GDB JIT interface: MCJIT registers each object file it loads here
+// with the section addresses rewritten to where they were loaded
+struct jit_code_entry {
+   struct jit_code_entry *next_entry;
+   struct jit_code_entry *prev_entry;
+   const char            *symfile_addr;
+   uint64_t               symfile_size;
+};
+
+struct jit_descriptor {
+   uint32_t               version;
+   uint32_t               action_flag;
+   struct jit_code_entry *relevant_entry;
+   struct jit_code_entry *first_entry;
+};
+
+extern struct jit_descriptor __jit_debug_descriptor __attribute__((weak));
+#endif
+
 #ifdef LLVM_MANGLES_NAMES
 static char *jit_str_add(char *p, const char *s)
 {
@@ -156,6 +180,57 @@ void jit_bind_fn(const char *name, void *ptr)
    }
 }
 
+#ifdef __GLIBC__
+static void jit_walk_elf(const char *image, size_t size, jit_sym_fn_t fn,
+                         void *context)
+{
+   const ElfW(Ehdr) *ehdr = (const ElfW(Ehdr) *)image;
+   if (size < sizeof(ElfW(Ehdr))
+       || memcmp(ehdr->e_ident, ELFMAG, SELFMAG) != 0
+       || ehdr->e_ident[EI_CLASS] != (sizeof(void *) == 8
+                                      ? ELFCLASS64 : ELFCLASS32)
+       || ehdr->e_shoff + ehdr->e_shnum * sizeof(ElfW(Shdr)) > size)
+      return;
+
+   const ElfW(Shdr) *shdrs = (const ElfW(Shdr) *)(image + ehdr->e_shoff);
+   for (unsigned i = 0; i < ehdr->e_shnum; i++) {
+      if (shdrs[i].sh_type != SHT_SYMTAB
+          || shdrs[i].sh_offset + shdrs[i].sh_size > size)
+         continue;
+
+      const ElfW(Sym) *syms =
+         (const ElfW(Sym) *)(image + shdrs[i].sh_offset);
+      const size_t nsyms = shdrs[i].sh_size / sizeof(ElfW(Sym));
+
+      for (size_t j = 0; j < nsyms; j++) {
+         const ElfW(Sym) *s = &(syms[j]);
+         if (ELF64_ST_TYPE(s->st_info) != STT_FUNC || s->st_size == 0
+             || s->st_shndx == SHN_UNDEF || s->st_shndx >= ehdr->e_shnum)
+            continue;
+
+         (*fn)(shdrs[s->st_shndx].sh_addr + s->st_value, s->st_size,
+               context);
+      }
+   }
+}
+#endif
+
+void jit_walk_fn_symbols(jit_sym_fn_t fn, void *context)
+{
+   // Call fn with the address and size of each function in the object
+   // files loaded by the JIT: nothing is reported for the old JIT or
+   // when running native code as perf reads those symbols itself
+
+#ifdef __GLIBC__
+   if (!using_jit || &__jit_debug_descriptor == NULL)
+      return;
+
+   for (struct jit_code_entry *e = __jit_debug_descriptor.first_entry;
+        e != NULL; e = e->next_entry)
+      jit_walk_elf(e->symfile_addr, e->symfile_size, fn, context);
+#endif
+}
+
 static void jit_init_llvm(const char *path)
 {
    char *error;
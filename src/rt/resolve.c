@@ -0,0 +1,262 @@
+//
+//  Copyright (C) 2015  Nick Gasson
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "util.h"
+#include "resolve.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if (defined __x86_64__ || defined __i386__) && defined __GNUC__
+#include <immintrin.h>
+#define RESOLVE_X86 1
+#endif
+
+// Fused resolution kernels for signals of enumerated types with at most
+// sixteen literals where the resolution function has been memoised. The
+// vector versions use byte shuffles to perform sixteen table lookups at
+// once and are selected at run time based on the host CPU.
+
+static const char *kernel_name = "scalar";
+
+////////////////////////////////////////////////////////////////////////////////
+// Scalar versions
+
+static bool resolve_copy_scalar(uint8_t *dst, const uint8_t *cur,
+                                const uint8_t *values, size_t n)
+{
+   uint8_t diff = 0;
+   for (size_t i = 0; i < n; i++) {
+      const uint8_t v = values[i];
+      diff |= cur[i] ^ v;
+      dst[i] = v;
+   }
+
+   return diff != 0;
+}
+
+static bool resolve_tab1_scalar(const int8_t tab1[16], uint8_t *dst,
+                                const uint8_t *cur, const uint8_t *values,
+                                size_t n)
+{
+   uint8_t diff = 0;
+   for (size_t i = 0; i < n; i++) {
+      const uint8_t r = tab1[values[i]];
+      diff |= cur[i] ^ r;
+      dst[i] = r;
+   }
+
+   return diff != 0;
+}
+
+static bool resolve_tab2_scalar(const int8_t tab2[16][16], unsigned nlits,
+                                uint8_t *dst, const uint8_t *cur,
+                                const uint8_t *a, const uint8_t *b, size_t n)
+{
+   uint8_t diff = 0;
+   for (size_t i = 0; i < n; i++) {
+      const uint8_t r = tab2[a[i]][b[i]];
+      diff |= cur[i] ^ r;
+      dst[i] = r;
+   }
+
+   return diff != 0;
+}
+
+#ifdef RESOLVE_X86
+
+////////////////////////////////////////////////////////////////////////////////
+// SSE4.1 versions
+
+__attribute__((target("sse4.1")))
+static bool resolve_copy_sse41(uint8_t *dst, const uint8_t *cur,
+                               const uint8_t *values, size_t n)
+{
+   __m128i diff = _mm_setzero_si128();
+
+   size_t i = 0;
+   for (; i + 16 <= n; i += 16) {
+      const __m128i old = _mm_loadu_si128((const __m128i *)(cur + i));
+      const __m128i r = _mm_loadu_si128((const __m128i *)(values + i));
+      diff = _mm_or_si128(diff, _mm_xor_si128(old, r));
+      _mm_storeu_si128((__m128i *)(dst + i), r);
+   }
+
+   const bool changed = !_mm_testz_si128(diff, diff);
+   return resolve_copy_scalar(dst + i, cur + i,
+                              values + i, n - i) || changed;
+}
+
+__attribute__((target("sse4.1")))
+static bool resolve_tab1_sse41(const int8_t tab1[16], uint8_t *dst,
+                               const uint8_t *cur, const uint8_t *values,
+                               size_t n)
+{
+   const __m128i table = _mm_loadu_si128((const __m128i *)tab1);
+   __m128i diff = _mm_setzero_si128();
+
+   size_t i = 0;
+   for (; i + 16 <= n; i += 16) {
+      const __m128i old = _mm_loadu_si128((const __m128i *)(cur + i));
+      const __m128i v = _mm_loadu_si128((const __m128i *)(values + i));
+      const __m128i r = _mm_shuffle_epi8(table, v);
+      diff = _mm_or_si128(diff, _mm_xor_si128(old, r));
+      _mm_storeu_si128((__m128i *)(dst + i), r);
+   }
+
+   const bool changed = !_mm_testz_si128(diff, diff);
+   return resolve_tab1_scalar(tab1, dst + i, cur + i,
+                              values + i, n - i) || changed;
+}
+
+__attribute__((target("sse4.1")))
+static bool resolve_tab2_sse41(const int8_t tab2[16][16], unsigned nlits,
+                               uint8_t *dst, const uint8_t *cur,
+                               const uint8_t *a, const uint8_t *b, size_t n)
+{
+   __m128i diff = _mm_setzero_si128();
+
+   size_t i = 0;
+   for (; i + 16 <= n; i += 16) {
+      const __m128i old = _mm_loadu_si128((const __m128i *)(cur + i));
+      const __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+      const __m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+
+      // Look up the column for every possible row and keep the bytes
+      // where the row matches the first driver
+      __m128i r = _mm_setzero_si128();
+      for (unsigned k = 0; k < nlits; k++) {
+         const __m128i row = _mm_loadu_si128((const __m128i *)tab2[k]);
+         const __m128i hit = _mm_cmpeq_epi8(va, _mm_set1_epi8(k));
+         r = _mm_blendv_epi8(r, _mm_shuffle_epi8(row, vb), hit);
+      }
+      diff = _mm_or_si128(diff, _mm_xor_si128(old, r));
+      _mm_storeu_si128((__m128i *)(dst + i), r);
+   }
+
+   const bool changed = !_mm_testz_si128(diff, diff);
+   return resolve_tab2_scalar(tab2, nlits, dst + i, cur + i,
+                              a + i, b + i, n - i) || changed;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// AVX2 versions
+
+__attribute__((target("avx2")))
+static bool resolve_copy_avx2(uint8_t *dst, const uint8_t *cur,
+                              const uint8_t *values, size_t n)
+{
+   __m256i diff = _mm256_setzero_si256();
+
+   size_t i = 0;
+   for (; i + 32 <= n; i += 32) {
+      const __m256i old = _mm256_loadu_si256((const __m256i *)(cur + i));
+      const __m256i r = _mm256_loadu_si256((const __m256i *)(values + i));
+      diff = _mm256_or_si256(diff, _mm256_xor_si256(old, r));
+      _mm256_storeu_si256((__m256i *)(dst + i), r);
+   }
+
+   const bool changed = !_mm256_testz_si256(diff, diff);
+   return resolve_copy_sse41(dst + i, cur + i,
+                             values + i, n - i) || changed;
+}
+
+__attribute__((target("avx2")))
+static bool resolve_tab1_avx2(const int8_t tab1[16], uint8_t *dst,
+                              const uint8_t *cur, const uint8_t *values,
+                              size_t n)
+{
+   const __m256i table =
+      _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)tab1));
+   __m256i diff = _mm256_setzero_si256();
+
+   size_t i = 0;
+   for (; i + 32 <= n; i += 32) {
+      const __m256i old = _mm256_loadu_si256((const __m256i *)(cur + i));
+      const __m256i v = _mm256_loadu_si256((const __m256i *)(values + i));
+      const __m256i r = _mm256_shuffle_epi8(table, v);
+      diff = _mm256_or_si256(diff, _mm256_xor_si256(old, r));
+      _mm256_storeu_si256((__m256i *)(dst + i), r);
+   }
+
+   const bool changed = !_mm256_testz_si256(diff, diff);
+   return resolve_tab1_sse41(tab1, dst + i, cur + i,
+                             values + i, n - i) || changed;
+}
+
+__attribute__((target("avx2")))
+static bool resolve_tab2_avx2(const int8_t tab2[16][16], unsigned nlits,
+                              uint8_t *dst, const uint8_t *cur,
+                              const uint8_t *a, const uint8_t *b, size_t n)
+{
+   __m256i diff = _mm256_setzero_si256();
+
+   size_t i = 0;
+   for (; i + 32 <= n; i += 32) {
+      const __m256i old = _mm256_loadu_si256((const __m256i *)(cur + i));
+      const __m256i va = _mm256_loadu_si256((const __m256i *)(a + i));
+      const __m256i vb = _mm256_loadu_si256((const __m256i *)(b + i));
+
+      __m256i r = _mm256_setzero_si256();
+      for (unsigned k = 0; k < nlits; k++) {
+         const __m256i row = _mm256_broadcastsi128_si256(
+            _mm_loadu_si128((const __m128i *)tab2[k]));
+         const __m256i hit = _mm256_cmpeq_epi8(va, _mm256_set1_epi8(k));
+         r = _mm256_blendv_epi8(r, _mm256_shuffle_epi8(row, vb), hit);
+      }
+
+      diff = _mm256_or_si256(diff, _mm256_xor_si256(old, r));
+      _mm256_storeu_si256((__m256i *)(dst + i), r);
+   }
+
+   const bool changed = !_mm256_testz_si256(diff, diff);
+   return resolve_tab2_sse41(tab2, nlits, dst + i, cur + i,
+                             a + i, b + i, n - i) || changed;
+}
+
+#endif  // RESOLVE_X86
+
+resolve_copy_fn_t resolve_copy = resolve_copy_scalar;
+resolve_tab1_fn_t resolve_tab1 = resolve_tab1_scalar;
+resolve_tab2_fn_t resolve_tab2 = resolve_tab2_scalar;
+
+void resolve_init(void)
+{
+#ifdef RESOLVE_X86
+   __builtin_cpu_init();
+
+   if (getenv("NVC_NO_SIMD") != NULL)
+      return;
+   else if (__builtin_cpu_supports("avx2")) {
+      resolve_copy = resolve_copy_avx2;
+      resolve_tab1 = resolve_tab1_avx2;
+      resolve_tab2 = resolve_tab2_avx2;
+      kernel_name  = "avx2";
+   }
+   else if (__builtin_cpu_supports("sse4.1")) {
+      resolve_copy = resolve_copy_sse41;
+      resolve_tab1 = resolve_tab1_sse41;
+      resolve_tab2 = resolve_tab2_sse41;
+      kernel_name  = "sse4.1";
+   }
+#endif
+}
+
+const char *resolve_kernel_name(void)
+{
+   return kernel_name;
+}
@@ -0,0 +1,47 @@
+//
+//  Copyright (C) 2015  Nick Gasson
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef _RESOLVE_H
+#define _RESOLVE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Each kernel computes the new resolved value, compares it with the
+// current value in cur, and stores it to dst in a single pass. The
+// destination may be the same as cur to update the value in place. The
+// return value is true if any byte changed.
+
+typedef bool (*resolve_copy_fn_t)(uint8_t *dst, const uint8_t *cur,
+                                  const uint8_t *values, size_t n);
+typedef bool (*resolve_tab1_fn_t)(const int8_t tab1[16], uint8_t *dst,
+                                  const uint8_t *cur, const uint8_t *values,
+                                  size_t n);
+typedef bool (*resolve_tab2_fn_t)(const int8_t tab2[16][16], unsigned nlits,
+                                  uint8_t *dst, const uint8_t *cur,
+                                  const uint8_t *a, const uint8_t *b,
+                                  size_t n);
+
+extern resolve_copy_fn_t resolve_copy;
+extern resolve_tab1_fn_t resolve_tab1;
+extern resolve_tab2_fn_t resolve_tab2;
+
+void resolve_init(void);
+const char *resolve_kernel_name(void);
+
+#endif  // _RESOLVE_H
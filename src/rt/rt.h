@@ -22,6 +22,7 @@
 #include "prim.h"
 
 #include <stdint.h>
+#include <sys/types.h>
 
 typedef struct watch watch_t;
 
@@ -65,7 +66,8 @@ typedef enum {
    NET_F_FORCED     = (1 << 2),
    NET_F_OWNS_MEM   = (1 << 3),
    NET_F_GLOBAL     = (1 << 4),
-   NET_F_LAST_VALUE = (1 << 5)
+   NET_F_LAST_VALUE = (1 << 5),
+   NET_F_ROTATE     = (1 << 6)
 } net_flags_t;
 
 typedef enum {
@@ -73,6 +75,10 @@ typedef enum {
    SCHED_STATIC     = (1 << 1)
 } sched_flags_t;
 
+// The upper bits of the _sched_event flags hold a mask of the values a
+// scalar signal must change to for the process to be woken
+#define SCHED_EDGE_SHIFT 16
+
 typedef enum {
    RT_START_OF_SIMULATION,
    RT_END_OF_SIMULATION,
@@ -83,6 +89,11 @@ typedef enum {
    RT_LAST_EVENT
 } rt_event_t;
 
+typedef enum {
+   EVENTQ_HEAP,
+   EVENTQ_WHEEL
+} eventq_kind_t;
+
 typedef enum {
    SEVERITY_NOTE,
    SEVERITY_WARNING,
@@ -90,11 +101,39 @@ typedef enum {
    SEVERITY_FAILURE
 } rt_severity_t;
 
+typedef enum {
+   RT_STATS_NONE,
+   RT_STATS_TEXT,
+   RT_STATS_JSON
+} rt_stats_fmt_t;
+
+typedef struct {
+   uint64_t now;
+   uint64_t events;
+   uint64_t cancelled;
+   uint64_t stale;
+   uint64_t cycles;
+   uint64_t time_steps;
+   uint64_t collapsed;
+   uint64_t timeouts;
+   uint64_t drivers;
+   uint64_t transactions;
+   uint64_t wakeups;
+   uint64_t res_calls;
+   uint64_t res_ns;
+   uint64_t vec_copy;
+   uint64_t vec_zero_copy;
+   uint64_t eventq_peak;
+   int      max_deltas;
+} rt_stats_t;
+
 void rt_start_of_tool(tree_t top, tree_rd_ctx_t ctx);
 void rt_end_of_tool(tree_t top);
 void rt_run_sim(uint64_t stop_time);
 void rt_run_interactive(uint64_t stop_time);
 void rt_restart(tree_t top);
+void rt_restore(tree_t top, const char *file);
+void rt_set_checkpoint(tree_t top, uint64_t when, const char *file);
 void rt_set_timeout_cb(uint64_t when, timeout_fn_t fn, void *user);
 watch_t *rt_set_event_cb(tree_t s, sig_event_fn_t fn, void *user,
                          bool postponed);
@@ -109,6 +148,9 @@ bool rt_can_create_delta(void);
 uint64_t rt_now(unsigned *deltas);
 void rt_stop(void);
 void rt_set_exit_severity(rt_severity_t severity);
+void rt_get_stats(rt_stats_t *stats);
+pid_t rt_fork(void);
+void rt_trace_dump(const char *file);
 
 void jit_init(ident_t top);
 void jit_shutdown(void);
@@ -116,6 +158,9 @@ void *jit_fun_ptr(const char *name, bool required);
 void *jit_var_ptr(const char *name, bool required);
 void jit_bind_fn(const char *name, void *ptr);
 
+typedef void (*jit_sym_fn_t)(uintptr_t addr, size_t size, void *context);
+void jit_walk_fn_symbols(jit_sym_fn_t fn, void *context);
+
 void shell_run(tree_t top, tree_rd_ctx_t ctx);
 
 text_buf_t *pprint(struct tree *t, const uint64_t *values, size_t len);
@@ -15,12 +15,17 @@
 //  along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 
+#define _GNU_SOURCE
+
 #include "rt.h"
 #include "tree.h"
 #include "lib.h"
 #include "util.h"
 #include "alloc.h"
 #include "heap.h"
+#include "wheel.h"
+#include "itree.h"
+#include "resolve.h"
 #include "common.h"
 #include "netdb.h"
 #include "cover.h"
@@ -39,6 +44,22 @@
 #include <sys/time.h>
 #include <sys/resource.h>
 #include <float.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <dlfcn.h>
+
+#if defined(HAVE_UCONTEXT_H)
+#include <ucontext.h>
+#elif defined(HAVE_SYS_UCONTEXT_H)
+#include <sys/ucontext.h>
+#endif
+
+#ifdef __GLIBC__
+#include <link.h>
+#endif
 
 #ifdef HAVE_ALLOCA_H
 #include <alloca.h>
@@ -46,11 +67,13 @@
 
 #define TRACE_DELTAQ  1
 #define TRACE_PENDING 0
+#define TRACE_EVENTQ  0   // Record for test/eventq_perf.c
 
 typedef void (*proc_fn_t)(int32_t reset);
 typedef uint64_t (*resolution_fn_t)(void *vals, int32_t n);
 
 typedef struct netgroup   netgroup_t;
+typedef struct netinfo    netinfo_t;
 typedef struct driver     driver_t;
 typedef struct rt_proc    rt_proc_t;
 typedef struct event      event_t;
@@ -60,17 +83,51 @@ typedef struct value      value_t;
 typedef struct watch_list watch_list_t;
 typedef struct res_memo   res_memo_t;
 typedef struct callback   callback_t;
+typedef struct deferred   deferred_t;
+typedef struct rt_thread  rt_thread_t;
+typedef struct rt_job     rt_job_t;
+typedef struct shadow     shadow_t;
+typedef struct txn        txn_t;
+typedef struct txn_part   txn_part_t;
+typedef struct batch      batch_t;
+typedef struct rt_clock   rt_clock_t;
+typedef struct rt_profile rt_profile_t;
+typedef struct rt_activity rt_activity_t;
+typedef struct rt_sample rt_sample_t;
+typedef struct rt_jit_sym rt_jit_sym_t;
+typedef struct rt_line rt_line_t;
+typedef struct rt_trace_hdr rt_trace_hdr_t;
+typedef struct rt_trace_rec rt_trace_rec_t;
+
+typedef enum {
+   TRACE_RUN,
+   TRACE_WAKEUP,
+   TRACE_SCHED,
+   TRACE_UPDATE,
+   TRACE_EVENT,
+   TRACE_LAST_KIND
+} rt_trace_kind_t;
+
+typedef struct {
+   const char *name;
+   size_t      item_sz;
+   size_t      peak;
+} rt_stack_stats_t;
 
 struct rt_proc {
-   tree_t    source;
-   proc_fn_t proc_fn;
-   uint32_t  wakeup_gen;
-   bool      postponed;
+   tree_t       source;
+   proc_fn_t    proc_fn;
+   uint32_t     wakeup_gen;
+   bool         postponed;
+   bool         armed;
+   unsigned     level;
+   sens_list_t *global;
 };
 
 typedef enum {
    E_TIMEOUT,
    E_DRIVER,
+   E_TRANSACTION,
    E_PROCESS
 } event_kind_t;
 
@@ -78,31 +135,131 @@ struct event {
    uint64_t      when;
    event_kind_t  kind;
    uint32_t      wakeup_gen;
+   uint32_t      driver;
    event_t      *delta_chain;
    rt_proc_t    *proc;
    netgroup_t   *group;
+   txn_t        *txn;
    timeout_fn_t  timeout_fn;
    void         *timeout_user;
 };
 
+struct txn_part {
+   netgroup_t *group;
+   uint32_t    driver;
+};
+
+struct txn {
+   unsigned   nparts;
+   unsigned   nlive;
+   txn_part_t parts[0];
+};
+
+#define MAX_BATCHES 4
+
+struct batch {
+   event_t    *event;
+   txn_part_t *parts;
+   unsigned    nparts;
+   unsigned    alloc;
+};
+
+struct rt_clock {
+   rt_clock_t *next;
+   rt_proc_t  *proc;
+   netgroup_t *group;
+   int         slot;
+   unsigned    phase;
+   bool        toggle;
+   uint64_t    after;
+   uint64_t    periods[2];
+   uint64_t    values[2];
+};
+
+struct rt_profile {
+   uint64_t activations;
+   uint64_t ns;
+   uint64_t txns;
+   uint64_t wakeups;
+};
+
+struct rt_activity {
+   uint64_t txns;
+   uint64_t events;
+   uint64_t steps;
+   uint64_t step_when;
+   uint32_t step_txns;
+   uint32_t step_events;
+   uint32_t max_step_txns;
+   uint32_t glitches;
+};
+
+struct rt_sample {
+   uintptr_t pc;
+   uint32_t  proc;
+};
+
+struct rt_jit_sym {
+   uintptr_t start;
+   size_t    size;
+   unsigned  proc;
+};
+
+struct rt_line {
+   uintptr_t addr;
+   uintptr_t fn_end;
+   unsigned  line;
+   unsigned  proc;
+};
+
+// The binary trace file is this header, a newline separated table of
+// process and group names, and then a ring of fixed size records
+// starting at the next 64 byte boundary
+struct rt_trace_hdr {
+   uint32_t magic;
+   uint32_t rec_size;
+   uint32_t n_procs;
+   uint32_t n_groups;
+   uint32_t names_size;
+   uint32_t rec_offset;
+   uint64_t capacity;
+   uint64_t head;
+};
+
+struct rt_trace_rec {
+   uint64_t when;
+   uint32_t delta;
+   uint32_t id;
+   uint32_t arg;
+   uint8_t  kind;
+   uint8_t  pad[3];
+};
+
 struct waveform {
-   uint64_t    when;
-   waveform_t *next;
-   value_t    *values;
+   uint64_t  when;
+   event_t  *event;
+   uint8_t   data[0];
 };
 
 struct sens_list {
    rt_proc_t    *proc;
    sens_list_t  *next;
    sens_list_t **reenq;
+   inode_t      *inode;
    uint32_t      wakeup_gen;
+   bool          is_static;
+   bool          fanout;
+   uint16_t      edges;
    netid_t       first;
    netid_t       last;
 };
 
 struct driver {
-   rt_proc_t  *proc;
-   waveform_t *waveforms;
+   rt_proc_t *proc;
+   uint8_t   *ring;
+   uint32_t   head;
+   uint32_t   count;
+   uint32_t   capacity;
 };
 
 struct value {
@@ -110,22 +267,35 @@ struct value {
    char     data[0];
 };
 
+// Fields read whenever a group is updated are packed into a single
+// cache line and everything else is kept in a parallel array of
+// netinfo_t indexed by group ID
 struct netgroup {
-   netid_t       first;
-   uint32_t      length;
    net_flags_t   flags;
-   void         *resolved;
-   void         *last_value;
-   value_t      *forcing;
+   uint32_t      length;
+   netid_t       first;
    uint16_t      size;
    uint16_t      n_drivers;
+   void         *resolved;
+   void         *last_value;
    driver_t     *drivers;
    res_memo_t   *resolution;
-   uint64_t      last_event;
-   tree_t        sig_decl;
-   value_t      *free_values;
+   uint16_t     *histogram;
    sens_list_t  *pending;
+} __attribute__((aligned(64)));
+
+struct netinfo {
+   tree_t        sig_decl;
+   uint64_t      last_event;
+   value_t      *forcing;
    watch_list_t *watching;
+   void         *scratch;
+   void        **shadow;
+};
+
+struct shadow {
+   void    **ptr;
+   netid_t   nid;
 };
 
 struct uarray {
@@ -171,13 +341,35 @@ struct watch_list {
 typedef enum {
    R_MEMO  = (1 << 0),
    R_IDENT = (1 << 1),
+   R_COMM  = (1 << 2),
+   R_ASSOC = (1 << 3),
+   R_IDEMP = (1 << 4),
 } res_flags_t;
 
+#define R_INCREMENTAL (R_MEMO | R_COMM | R_ASSOC)
+
+typedef enum {
+   RES_NONE,
+   RES_TABLE1,
+   RES_TABLE2,
+   RES_INCREMENTAL,
+   RES_CALL,
+
+   RES_LAST_PATH
+} res_path_t;
+
+typedef struct {
+   uint64_t calls;
+   uint64_t ns;
+} res_stats_t;
+
 struct res_memo {
    resolution_fn_t fn;
    res_flags_t     flags;
    int8_t          tab2[16][16];
    int8_t          tab1[16];
+   int8_t         *tabmask;
+   unsigned        nlits;
 };
 
 typedef enum {
@@ -192,12 +384,62 @@ struct callback {
    callback_t    *next;
 };
 
+typedef enum {
+   D_SCHED_WAVEFORM,
+   D_SCHED_EVENT,
+   D_SCHED_PROCESS,
+   D_ASSERT_FAIL,
+   D_ENV_STOP,
+   D_FILE_WRITE,
+   D_FILE_CLOSE,
+   D_FATAL
+} deferred_kind_t;
+
+struct deferred {
+   deferred_kind_t  kind;
+   const int32_t   *nids;
+   int32_t          n;
+   int32_t          flags;
+   int32_t          slot;
+   int64_t          after;
+   int64_t          reject;
+   size_t           data;
+   const char      *module;
+   FILE            *fp;
+   const loc_t     *loc;
+};
+
+struct rt_thread {
+   pthread_t   thread;
+   jmp_buf     abandon;
+   void       *tmp_stack;
+   deferred_t *ops;
+   unsigned    n_ops;
+   unsigned    ops_alloc;
+   uint8_t    *data;
+   size_t      data_len;
+   size_t      data_alloc;
+};
+
+struct rt_job {
+   rt_proc_t   *proc;
+   sens_list_t *sens;
+   rt_thread_t *thread;
+   unsigned     first_op;
+   unsigned     last_op;
+};
+
 static struct rt_proc   *procs = NULL;
-static struct rt_proc   *active_proc = NULL;
+static __thread struct rt_proc *active_proc = NULL;
 static struct loaded    *loaded = NULL;
 static struct run_queue  run_queue;
 
 static heap_t        eventq_heap = NULL;
+static wheel_t       eventq_wheel = NULL;
+static eventq_kind_t eventq_kind = EVENTQ_HEAP;
+#if TRACE_EVENTQ > 0
+static FILE         *eventq_trace = NULL;
+#endif
 static size_t        n_procs = 0;
 static uint64_t      now = 0;
 static int           iteration = -1;
@@ -208,7 +450,13 @@ static jmp_buf       fatal_jmp;
 static bool          aborted = false;
 static netdb_t      *netdb = NULL;
 static netgroup_t   *groups = NULL;
-static sens_list_t  *pending = NULL;
+static netinfo_t    *infos = NULL;
+static uint8_t      *arena = NULL;
+static size_t        arena_size = 0;
+static shadow_t     *shadows = NULL;
+static unsigned      n_shadows = 0;
+static unsigned      shadows_alloc = 0;
+static itree_t       pending = NULL;
 static sens_list_t  *resume = NULL;
 static sens_list_t  *postponed = NULL;
 static watch_t      *watches = NULL;
@@ -221,35 +469,107 @@ static uint32_t      global_tmp_alloc;
 static hash_t       *res_memo_hash = NULL;
 static side_effect_t init_side_effect = SIDE_EFFECT_ALLOW;
 static bool          force_stop;
+static bool          restoring = false;
+static bool          profile_res = false;
+static res_stats_t   res_stats[RES_LAST_PATH];
 static bool          can_create_delta;
 static callback_t   *global_cbs[RT_LAST_EVENT];
 static rt_severity_t exit_severity = SEVERITY_ERROR;
+static uint64_t      n_executed = 0;
+static uint64_t      n_cancelled = 0;
+static uint64_t      n_cycles = 0;
+static uint64_t      n_collapsed = 0;
+static uint64_t      n_time_steps = 0;
+static uint64_t      n_stale = 0;
+static uint64_t      n_events[4];
+static uint64_t      n_vec_copy = 0;
+static uint64_t      n_vec_zero_copy = 0;
+static int           max_deltas = 0;
+static size_t        eventq_peak = 0;
+static rt_stack_stats_t stack_stats[4];
+static bool          levelise = false;
+static unsigned      max_level = 0;
+static sens_list_t **level_wake = NULL;
+static sens_list_t **fanout = NULL;
+static uint32_t     *fanout_start = NULL;
+static uint64_t      checkpoint_at = UINT64_MAX;
+static char         *checkpoint_file = NULL;
+static tree_t        checkpoint_top = NULL;
+static rt_profile_t *profile = NULL;
+static rt_proc_t    *profile_cause = NULL;
+static rt_activity_t *activity = NULL;
+static rt_trace_hdr_t *trace_hdr = NULL;
+static rt_trace_rec_t *trace_recs = NULL;
+static size_t        trace_map_sz = 0;
+static rt_sample_t  *samples = NULL;
+static uint64_t      n_samples = 0;
+static rt_jit_sym_t *jit_syms = NULL;
+static size_t        n_jit_syms = 0;
+static rt_line_t    *jit_lines = NULL;
+static size_t        n_jit_lines = 0;
+static __thread rt_proc_t *sample_proc = NULL;
 
 static rt_alloc_stack_t event_stack = NULL;
-static rt_alloc_stack_t waveform_stack = NULL;
 static rt_alloc_stack_t sens_list_stack = NULL;
 static rt_alloc_stack_t watch_stack = NULL;
 static rt_alloc_stack_t callback_stack = NULL;
+static rt_pool_t        value_pool = NULL;
+
+static batch_t      batches[MAX_BATCHES];
+static unsigned     n_batches = 0;
+static rt_clock_t  *clocks = NULL;
 
 static netgroup_t **active_groups;
 static unsigned     n_active_groups = 0;
 static unsigned     n_active_alloc = 0;
 
+static rt_thread_t          *threads = NULL;
+static unsigned              n_threads = 1;
+static __thread rt_thread_t *this_thread = NULL;
+static rt_job_t             *jobs = NULL;
+static unsigned              n_jobs = 0;
+static unsigned              jobs_alloc = 0;
+static unsigned              next_job = 0;
+static unsigned              pool_gen = 0;
+static unsigned              pool_active = 0;
+static bool                  pool_shutdown = false;
+static pthread_mutex_t       pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t        pool_start = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t        pool_done = PTHREAD_COND_INITIALIZER;
+static pthread_mutex_t       serial_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void deltaq_insert(event_t *e);
+static void rt_flush_batches(void);
 static void deltaq_insert_proc(uint64_t delta, rt_proc_t *wake);
-static void deltaq_insert_driver(uint64_t delta, netgroup_t *group,
-                                 rt_proc_t *driver);
-static bool rt_sched_driver(netgroup_t *group, uint64_t after,
-                            uint64_t reject, value_t *values);
-static void rt_sched_event(sens_list_t **list, netid_t first, netid_t last,
-                           rt_proc_t *proc, bool is_static);
+static event_t *deltaq_insert_driver(uint64_t delta, netgroup_t *group,
+                                     rt_proc_t *proc, int driver);
+static void rt_sched_driver(netgroup_t *group, uint64_t after,
+                            uint64_t reject, const void *values, int slot);
+static void rt_sched_event(sens_list_t **list, rt_proc_t *proc,
+                           bool is_static, uint16_t edges);
+static void rt_clock_cb(uint64_t when, void *user);
+static void rt_free_clocks(void);
+static void rt_sched_global(netid_t first, netid_t last, rt_proc_t *proc,
+                            bool is_static);
 static void *rt_tmp_alloc(size_t sz);
 static value_t *rt_alloc_value(netgroup_t *g);
 static tree_t rt_recall_tree(const char *unit, int32_t where);
 static res_memo_t *rt_memo_resolution_fn(type_t type, resolution_fn_t fn);
 static void _tracef(const char *fmt, ...);
 
+#define WAVE_STRIDE(valuesz) (sizeof(waveform_t) + (((valuesz) + 7) & ~7))
+
+#define CHECKPOINT_MAGIC 0x4e564b50
+#define TRACE_MAGIC      0x4e565452
+
+#define SAMPLE_HZ      1000
+#define SAMPLE_MAX     (1 << 20)
+#define JIT_SYM_MAX_SZ 0x10000
+
 #define GLOBAL_TMP_STACK_SZ (256 * 1024)
 #define PROC_TMP_STACK_SZ   (64 * 1024)
+#define PARALLEL_MIN_PROCS  32
+#define JOB_CHUNK           8
 
 #define TRACE(...) do {                                 \
       if (unlikely(trace_on)) _tracef(__VA_ARGS__);     \
@@ -271,6 +591,11 @@ static void _tracef(const char *fmt, ...);
 ////////////////////////////////////////////////////////////////////////////////
 // Utilities
 
+static inline netinfo_t *rt_group_info(const netgroup_t *g)
+{
+   return &(infos[g - groups]);
+}
+
 static const char *fmt_group(const netgroup_t *g)
 {
    static const size_t BUF_LEN = 512;
@@ -279,14 +604,16 @@ static const char *fmt_group(const netgroup_t *g)
    const char *eptr = buf + BUF_LEN;
    char *p = buf;
 
-   p += checked_sprintf(p, eptr - p, "%s", istr(tree_ident(g->sig_decl)));
+   tree_t decl = rt_group_info(g)->sig_decl;
 
-   groupid_t sig_group0 = netdb_lookup(netdb, tree_net(g->sig_decl, 0));
+   p += checked_sprintf(p, eptr - p, "%s", istr(tree_ident(decl)));
+
+   groupid_t sig_group0 = netdb_lookup(netdb, tree_net(decl, 0));
    netid_t sig_net0 = groups[sig_group0].first;
    int offset = g->first - sig_net0;
 
    const int length = g->length;
-   type_t type = tree_type(g->sig_decl);
+   type_t type = tree_type(decl);
    while (type_is_array(type)) {
       const int stride = type_width(type_elem(type));
       const int ndims = type_dims(type);
@@ -343,27 +670,241 @@ static inline uint64_t heap_key(uint64_t when, event_kind_t kind)
    return (when << 2) | (kind & 3);
 }
 
+static inline waveform_t *rt_wave(const driver_t *d, size_t valuesz,
+                                  unsigned i)
+{
+   // Transactions are stored in a ring with the current driving value
+   // at index zero followed by pending transactions in time order
+   const unsigned slot = (d->head + i) & (d->capacity - 1);
+   return (waveform_t *)(d->ring + (slot * WAVE_STRIDE(valuesz)));
+}
+
+static inline void *rt_driving_value(const netgroup_t *g,
+                                     const driver_t *d)
+{
+   return rt_wave(d, g->size * g->length, 0)->data;
+}
+
+static inline int rt_find_driver(const netgroup_t *g, const rt_proc_t *proc)
+{
+   int driver;
+   for (driver = 0; driver < g->n_drivers; driver++) {
+      if (likely(g->drivers[driver].proc == proc))
+         break;
+   }
+
+   return driver;
+}
+
+static inline size_t eventq_size(void)
+{
+   if (eventq_kind == EVENTQ_WHEEL)
+      return wheel_size(eventq_wheel);
+   else
+      return heap_size(eventq_heap);
+}
+
+static inline void eventq_insert(uint64_t key, event_t *e)
+{
+#if TRACE_EVENTQ > 0
+   fprintf(eventq_trace, "+ %"PRIu64"\n", key);
+#endif
+
+   if (eventq_kind == EVENTQ_WHEEL)
+      wheel_insert(eventq_wheel, key, e);
+   else
+      heap_insert(eventq_heap, key, e);
+
+   eventq_peak = MAX(eventq_peak, eventq_size());
+}
+
+static inline event_t *eventq_min(void)
+{
+   if (eventq_kind == EVENTQ_WHEEL)
+      return wheel_min(eventq_wheel);
+   else
+      return heap_min(eventq_heap);
+}
+
+static inline event_t *eventq_extract_min(void)
+{
+#if TRACE_EVENTQ > 0
+   fprintf(eventq_trace, "-\n");
+#endif
+
+   if (eventq_kind == EVENTQ_WHEEL)
+      return wheel_extract_min(eventq_wheel);
+   else
+      return heap_extract_min(eventq_heap);
+}
+
+static void eventq_new(void)
+{
+   eventq_kind = opt_get_int("rt-event-queue");
+
+#if TRACE_EVENTQ > 0
+   if ((eventq_trace = fopen("eventq.trace", "w")) == NULL)
+      fatal_errno("eventq.trace");
+#endif
+
+   if (eventq_kind == EVENTQ_WHEEL)
+      eventq_wheel = wheel_new();
+   else
+      eventq_heap = heap_new(512);
+}
+
+static void eventq_free(void)
+{
+   if (eventq_heap != NULL)
+      heap_free(eventq_heap);
+   if (eventq_wheel != NULL)
+      wheel_free(eventq_wheel);
+
+   eventq_heap  = NULL;
+   eventq_wheel = NULL;
+
+#if TRACE_EVENTQ > 0
+   if (eventq_trace != NULL)
+      fclose(eventq_trace);
+   eventq_trace = NULL;
+#endif
+}
+
+static inline void rt_serial_begin(void)
+{
+   // Kernel state touched by these calls is not thread safe
+   if (unlikely(this_thread != NULL))
+      pthread_mutex_lock(&serial_lock);
+}
+
+static inline void rt_serial_end(void)
+{
+   if (unlikely(this_thread != NULL))
+      pthread_mutex_unlock(&serial_lock);
+}
+
+static void rt_abandon_job(void) __attribute__((noreturn));
+
+static void rt_abandon_job(void)
+{
+   // The process made a call that ends the simulation when it is
+   // replayed so the rest of this run must not happen
+   longjmp(this_thread->abandon, 1);
+}
+
+static deferred_t *rt_defer(deferred_kind_t kind, const void *data,
+                            size_t len)
+{
+   // Record a kernel call made by a process running on a worker thread
+   // so that it can be replayed in the same order as a sequential run
+   // once every process in the batch has suspended
+
+   rt_thread_t *t = this_thread;
+
+   if (unlikely(t->n_ops == t->ops_alloc)) {
+      t->ops_alloc = MAX(t->ops_alloc * 2, 64);
+      t->ops = xrealloc(t->ops, t->ops_alloc * sizeof(deferred_t));
+   }
+
+   const size_t aligned = (len + 7) & ~7;
+   if (unlikely(t->data_len + aligned > t->data_alloc)) {
+      t->data_alloc = MAX(t->data_alloc * 2, t->data_len + aligned);
+      t->data = xrealloc(t->data, t->data_alloc);
+   }
+
+   deferred_t *d = &(t->ops[(t->n_ops)++]);
+   d->kind = kind;
+   d->data = t->data_len;
+
+   memcpy(t->data + t->data_len, data, len);
+   t->data_len += aligned;
+
+   return d;
+}
+
+static void rt_fatal_at(const loc_t *loc, const char *fmt, ...)
+   __attribute__((format(printf, 2, 3), noreturn));
+
+static void rt_fatal_at(const loc_t *loc, const char *fmt, ...)
+{
+   // A process on a worker thread must not exit before the calls made
+   // by earlier processes in the batch are replayed so the error is
+   // raised from the main thread instead
+
+   va_list ap;
+   va_start(ap, fmt);
+   char *msg = xvasprintf(fmt, ap);
+   va_end(ap);
+
+   if (unlikely(this_thread != NULL)) {
+      deferred_t *d = rt_defer(D_FATAL, msg, strlen(msg) + 1);
+      d->loc = loc;
+      free(msg);
+      rt_abandon_job();
+   }
+
+   if (loc != NULL)
+      fatal_at(loc, "%s", msg);
+   else
+      fatal("%s", msg);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Runtime support functions
 
-void     *_tmp_stack;
-uint32_t  _tmp_alloc;
+// Generated code reaches the temporary stack of the current thread
+// through _tmp_stack_ptr rather than thread-local globals as the JIT
+// cannot resolve TLS relocations
+typedef struct {
+   void     *base;
+   uint32_t  alloc;
+} tmp_stack_t;
+
+static __thread tmp_stack_t tmp_stack;
+
+tmp_stack_t *_tmp_stack_ptr(void)
+{
+   return &tmp_stack;
+}
 
 void _sched_process(int64_t delay)
 {
+   if (unlikely(this_thread != NULL)) {
+      deferred_t *d = rt_defer(D_SCHED_PROCESS, NULL, 0);
+      d->after = delay;
+      return;
+   }
+
    TRACE("_sched_process delay=%s", fmt_time(delay));
    deltaq_insert_proc(delay, active_proc);
 }
 
 void _sched_waveform(void *_nids, void *values, int32_t n,
-                     int64_t after, int64_t reject)
+                     int64_t after, int64_t reject, int32_t slot)
 {
    const int32_t *nids = _nids;
 
-   TRACE("_sched_waveform %s values=%s n=%d after=%s reject=%s",
+   if (unlikely(this_thread != NULL)) {
+      int first = 0;
+      while ((first < n) && (nids[first] == NETID_INVALID))
+         first++;
+
+      if (first < n) {
+         const int size = groups[netdb_lookup(netdb, nids[first])].size;
+         deferred_t *d = rt_defer(D_SCHED_WAVEFORM, values, n * size);
+         d->nids   = nids;
+         d->n      = n;
+         d->after  = after;
+         d->reject = reject;
+         d->slot   = slot;
+      }
+      return;
+   }
+
+   TRACE("_sched_waveform %s values=%s n=%d after=%s reject=%s slot=%d",
          fmt_net(nids[0]),
          fmt_values(values, n * groups[netdb_lookup(netdb, nids[0])].size),
-         n, fmt_time(after), fmt_time(reject));
+         n, fmt_time(after), fmt_time(reject), slot);
 
    if (unlikely(active_proc->postponed && (after == 0)))
       fatal("postponed process %s cannot cause a delta cycle",
@@ -375,12 +916,8 @@ void _sched_waveform(void *_nids, void *values, int32_t n,
       if (likely(nid != NETID_INVALID)) {
          netgroup_t *g = &(groups[netdb_lookup(netdb, nid)]);
 
-         value_t *values_copy = rt_alloc_value(g);
-         memcpy(values_copy->data, (uint8_t *)values + (offset * g->size),
-                g->size * g->length);
-
-         if (!rt_sched_driver(g, after, reject, values_copy))
-            deltaq_insert_driver(after, g, active_proc);
+         rt_sched_driver(g, after, reject,
+                         (uint8_t *)values + (offset * g->size), slot);
 
          offset += g->length;
       }
@@ -391,25 +928,67 @@ void _sched_waveform(void *_nids, void *values, int32_t n,
    assert(offset == n);
 }
 
+void _sched_clock(void *_nids, void *value0, void *value1, int64_t after,
+                  int64_t period0, int64_t period1, int32_t toggle,
+                  int32_t slot)
+{
+   const int32_t *nids = _nids;
+
+   TRACE("_sched_clock %s after=%s periods=%s,%s proc %s", fmt_net(nids[0]),
+         fmt_time(after), fmt_time(period0), fmt_time(period1),
+         istr(tree_ident(active_proc->source)));
+
+   netgroup_t *g = &(groups[netdb_lookup(netdb, nids[0])]);
+   assert(g->length == 1);
+   assert(g->size <= sizeof(uint64_t));
+
+   rt_clock_t *c = xmalloc(sizeof(rt_clock_t));
+   c->next       = clocks;
+   c->proc       = active_proc;
+   c->group      = g;
+   c->slot       = slot;
+   c->phase      = 0;
+   c->toggle     = toggle;
+   c->after      = after;
+   c->periods[0] = period0;
+   c->periods[1] = period1;
+
+   memcpy(&(c->values[0]), value0, g->size);
+   memcpy(&(c->values[1]), value1, g->size);
+
+   clocks = c;
+
+   // The first edge is scheduled in the same cycle the process would
+   // have run for the first time
+   rt_set_timeout_cb(0, rt_clock_cb, c);
+}
+
 void _sched_event(void *_nids, int32_t n, int32_t flags)
 {
    const int32_t *nids = _nids;
 
+   if (unlikely(this_thread != NULL)) {
+      deferred_t *d = rt_defer(D_SCHED_EVENT, NULL, 0);
+      d->nids  = nids;
+      d->n     = n;
+      d->flags = flags;
+      return;
+   }
+
    TRACE("_sched_event %s n=%d flags=%d proc %s", fmt_net(nids[0]), n,
          flags, istr(tree_ident(active_proc->source)));
 
    netgroup_t *g0 = &(groups[netdb_lookup(netdb, nids[0])]);
 
-   if (g0->length == n) {
-      rt_sched_event(&(g0->pending), NETID_INVALID, NETID_INVALID,
-                     active_proc, flags & SCHED_STATIC);
-   }
+   if (g0->length == n)
+      rt_sched_event(&(g0->pending), active_proc, flags & SCHED_STATIC,
+                     flags >> SCHED_EDGE_SHIFT);
    else {
       const bool global = !!(flags & SCHED_SEQUENTIAL);
       if (global) {
          // Place on the global pending list
-         rt_sched_event(&pending, nids[0], nids[n - 1], active_proc,
-                        flags & SCHED_STATIC);
+         rt_sched_global(nids[0], nids[n - 1], active_proc,
+                         flags & SCHED_STATIC);
       }
 
       int offset = 0;
@@ -419,8 +998,8 @@ void _sched_event(void *_nids, int32_t n, int32_t flags)
             g->flags |= NET_F_GLOBAL;
          else {
             // Place on the net group's pending list
-            rt_sched_event(&(g->pending), NETID_INVALID, NETID_INVALID,
-                           active_proc, flags & SCHED_STATIC);
+            rt_sched_event(&(g->pending), active_proc,
+                           flags & SCHED_STATIC, 0);
          }
 
          offset += g->length;
@@ -447,17 +1026,14 @@ void _alloc_driver(const int32_t *all_nets, int32_t all_length,
       offset += g->length;
 
       // Try to find this process in the list of existing drivers
-      int driver;
-      for (driver = 0; driver < g->n_drivers; driver++) {
-         if (likely(g->drivers[driver].proc == active_proc))
-            break;
-      }
+      const int driver = rt_find_driver(g, active_proc);
 
       // Allocate memory for drivers on demand
       if (driver == g->n_drivers) {
          if ((g->n_drivers == 1) && (g->resolution == NULL))
-            fatal_at(tree_loc(g->sig_decl), "group %s has multiple drivers "
-                     "but no resolution function", fmt_group(g));
+            fatal_at(tree_loc(rt_group_info(g)->sig_decl), "group %s has "
+                     "multiple drivers but no resolution function",
+                     fmt_group(g));
 
          const size_t driver_sz = sizeof(struct driver);
          g->drivers = xrealloc(g->drivers, (driver + 1) * driver_sz);
@@ -473,25 +1049,54 @@ void _alloc_driver(const int32_t *all_nets, int32_t all_length,
 
          const void *src = (init == NULL) ? g->resolved : initp;
 
-         // Assign the initial value of the driver
-         waveform_t *dummy = rt_alloc(waveform_stack);
-         dummy->when   = 0;
-         dummy->next   = NULL;
-         dummy->values = rt_alloc_value(g);
-         memcpy(dummy->values->data, src, g->length * g->size);
+         // The ring initially has space for the current value and a
+         // single pending transaction which is the common case
+         const size_t valuesz = g->length * g->size;
+         d->capacity = 2;
+         d->ring     = rt_pool_alloc(value_pool,
+                                     d->capacity * WAVE_STRIDE(valuesz));
+         d->head     = 0;
+         d->count    = 1;
 
-         d->waveforms = dummy;
+         // Assign the initial value of the driver
+         waveform_t *w0 = rt_wave(d, valuesz, 0);
+         w0->when  = 0;
+         w0->event = NULL;
+         memcpy(w0->data, src, valuesz);
       }
 
       initp += g->length * g->size;
    }
 }
 
-void *_resolved_address(int32_t nid)
+void *_resolved_address(int32_t nid, void **shadow)
 {
    groupid_t gid = netdb_lookup(netdb, nid);
    netgroup_t *g = &(groups[gid]);
+   netinfo_t *info = &(infos[gid]);
    TRACE("_resolved_address %d %p", nid, g->resolved);
+
+   if (g->flags & NET_F_ROTATE) {
+      // The value buffers can only be swapped if there is a single
+      // pointer to the resolved value outside the kernel
+      if ((nid != g->first)
+          || (info->shadow != NULL && info->shadow != shadow))
+         g->flags &= ~NET_F_ROTATE;
+      else
+         info->shadow = shadow;
+   }
+
+   // Remember the shadow variable so it can be updated when the value
+   // is moved into the arena
+   if (unlikely(n_shadows == shadows_alloc)) {
+      shadows_alloc = MAX(shadows_alloc * 2, 128);
+      shadows = xrealloc(shadows, shadows_alloc * sizeof(shadow_t));
+   }
+
+   shadows[n_shadows].ptr = shadow;
+   shadows[n_shadows].nid = nid;
+   n_shadows++;
+
    return g->resolved;
 }
 
@@ -504,6 +1109,23 @@ void _needs_last_value(const int32_t *nids, int32_t n)
       netgroup_t *g = &(groups[netdb_lookup(netdb, nids[offset])]);
       g->flags |= NET_F_LAST_VALUE;
 
+      if ((g->flags & NET_F_OWNS_MEM) && (g->length == n)) {
+         // The whole signal is a single group so rather than copying
+         // the old value to last_value on every event keep a third
+         // buffer to resolve into and rotate the pointers
+         const size_t valuesz = g->length * g->size;
+         uint8_t *mem = xmalloc(valuesz * 3);
+         memcpy(mem, g->resolved, valuesz);
+         memcpy(mem + valuesz, g->last_value, valuesz);
+         free(g->resolved);
+
+         g->resolved   = mem;
+         g->last_value = mem + valuesz;
+         g->flags     |= NET_F_ROTATE;
+
+         rt_group_info(g)->scratch = mem + 2 * valuesz;
+      }
+
       offset += g->length;
    }
 }
@@ -540,10 +1162,11 @@ void _set_initial(int32_t nid, const uint8_t *values, const int32_t *size_list,
 
       const int size = size_list[part * 2];
 
-      assert(g->sig_decl == NULL);
+      assert(infos[gid].sig_decl == NULL);
       assert(remain >= g->length);
 
-      g->sig_decl   = decl;
+      infos[gid].sig_decl = decl;
+
       g->resolution = memo;
       g->size       = size;
       g->resolved   = res_mem;
@@ -583,6 +1206,20 @@ void _assert_fail(const uint8_t *msg, int32_t msg_len, int8_t severity,
 
    assert(severity <= SEVERITY_FAILURE);
 
+   if (unlikely(this_thread != NULL)) {
+      const size_t len = (msg_len >= 0) ? msg_len : strlen((const char *)msg);
+      deferred_t *d = rt_defer(D_ASSERT_FAIL, msg, len);
+      d->n      = len;
+      d->flags  = severity;
+      d->after  = where;
+      d->module = module;
+
+      if (severity >= exit_severity)
+         rt_abandon_job();
+
+      return;
+   }
+
    const char *levels[] = {
       "Note", "Warning", "Error", "Failure"
    };
@@ -645,42 +1282,42 @@ void _bounds_fail(int32_t where, const char *module, int32_t value,
 
    switch ((bounds_kind_t)kind) {
    case BOUNDS_ARRAY_TO:
-      fatal_at(loc, "array index %d outside bounds %d to %d%s",
-               value, min, max, suffix);
+      rt_fatal_at(loc, "array index %d outside bounds %d to %d%s",
+                  value, min, max, suffix);
       break;
    case BOUNDS_ARRAY_DOWNTO:
-      fatal_at(loc, "array index %d outside bounds %d downto %d%s",
-               value, max, min, suffix);
+      rt_fatal_at(loc, "array index %d outside bounds %d downto %d%s",
+                  value, max, min, suffix);
       break;
 
    case BOUNDS_ENUM:
-      fatal_at(loc, "value %d outside %s bounds %d to %d%s",
-               value, type_pp(tree_type(t)), min, max, suffix);
+      rt_fatal_at(loc, "value %d outside %s bounds %d to %d%s",
+                  value, type_pp(tree_type(t)), min, max, suffix);
       break;
 
    case BOUNDS_TYPE_TO:
-      fatal_at(loc, "value %d outside bounds %d to %d%s",
-               value, min, max, suffix);
+      rt_fatal_at(loc, "value %d outside bounds %d to %d%s",
+                  value, min, max, suffix);
       break;
 
    case BOUNDS_TYPE_DOWNTO:
-      fatal_at(loc, "value %d outside bounds %d downto %d%s",
-               value, max, min, suffix);
+      rt_fatal_at(loc, "value %d outside bounds %d downto %d%s",
+                  value, max, min, suffix);
       break;
 
    case BOUNDS_ARRAY_SIZE:
-      fatal_at(loc, "length of target %d does not match length of value %d%s",
-               min, max, suffix);
+      rt_fatal_at(loc, "length of target %d does not match length of "
+                  "value %d%s", min, max, suffix);
       break;
 
    case BOUNDS_INDEX_TO:
-      fatal_at(loc, "index %d violates constraint bounds %d to %d",
-               value, min, max);
+      rt_fatal_at(loc, "index %d violates constraint bounds %d to %d",
+                  value, min, max);
       break;
 
    case BOUNDS_INDEX_DOWNTO:
-      fatal_at(loc, "index %d violates constraint bounds %d downto %d",
-               value, max, min);
+      rt_fatal_at(loc, "index %d violates constraint bounds %d downto %d",
+                  value, max, min);
       break;
    }
 }
@@ -696,8 +1333,8 @@ int64_t _value_attr(const uint8_t *raw_str, int32_t str_len,
 
    int64_t result;
    if (!parse_value(tree_type(t), str, &result))
-      fatal_at(tree_loc(t), "string \"%s\" is not a valid "
-               "representation of type %s", str, type_pp(tree_type(t)));
+      rt_fatal_at(tree_loc(t), "string \"%s\" is not a valid "
+                  "representation of type %s", str, type_pp(tree_type(t)));
 
    free(str);
    return result;
@@ -706,13 +1343,13 @@ int64_t _value_attr(const uint8_t *raw_str, int32_t str_len,
 void _div_zero(int32_t where, const char *module)
 {
    tree_t t = rt_recall_tree(module, where);
-   fatal_at(tree_loc(t), "division by zero");
+   rt_fatal_at(tree_loc(t), "division by zero");
 }
 
 void _null_deref(int32_t where, const char *module)
 {
    tree_t t = rt_recall_tree(module, where);
-   fatal_at(tree_loc(t), "null access dereference");
+   rt_fatal_at(tree_loc(t), "null access dereference");
 }
 
 int64_t _std_standard_now(void)
@@ -720,8 +1357,21 @@ int64_t _std_standard_now(void)
    return now;
 }
 
+int8_t _restoring(void)
+{
+   return restoring;
+}
+
 void _nvc_env_stop(int32_t finish, int32_t have_status, int32_t status)
 {
+   if (unlikely(this_thread != NULL)) {
+      deferred_t *d = rt_defer(D_ENV_STOP, NULL, 0);
+      d->flags = finish;
+      d->n     = have_status;
+      d->after = status;
+      rt_abandon_job();
+   }
+
    if (have_status)
       notef("%s called with status %d", finish ? "FINISH" : "STOP", status);
    else
@@ -744,24 +1394,42 @@ void *_vec_load(const int32_t *nids, void *where,
 
    assert((g->flags & NET_F_LAST_VALUE) || !last);
 
+   const uint8_t *base =
+      (uint8_t *)(unlikely(last) ? g->last_value : g->resolved)
+      + (skip * g->size);
+
    if (offset + g->length - skip > high) {
-      // If the signal data is already contiguous return a pointer to
-      // that rather than copying into the user buffer
-      void *r = unlikely(last) ? g->last_value : g->resolved;
-      return (uint8_t *)r + (skip * g->size);
+      if (unlikely(profile_res))
+         __atomic_add_fetch(&n_vec_zero_copy, 1, __ATOMIC_RELAXED);
+      return (void *)base;
    }
 
-   uint8_t *p = where;
+   // Groups for consecutive nets are usually adjacent in the arena so
+   // only copy into the user buffer once a gap is found
+   const uint8_t *next = base;
+   uint8_t *p = NULL;
    for (;;) {
       const int to_copy = MIN(high - offset + 1, g->length - skip);
       const int bytes   = to_copy * g->size;
 
-      const void *src = unlikely(last) ? g->last_value : g->resolved;
+      const uint8_t *src =
+         (uint8_t *)(unlikely(last) ? g->last_value : g->resolved)
+         + (skip * g->size);
 
-      memcpy(p, (uint8_t *)src + (skip * g->size), bytes);
+      if (p == NULL && src != next) {
+         const size_t done = next - base;
+         memcpy(where, base, done);
+         p = (uint8_t *)where + done;
+      }
+
+      if (p != NULL) {
+         memcpy(p, src, bytes);
+         p += bytes;
+      }
+      else
+         next = src + bytes;
 
       offset += g->length - skip;
-      p += bytes;
 
       if (offset > high)
          break;
@@ -771,8 +1439,12 @@ void *_vec_load(const int32_t *nids, void *where,
       skip = nids[offset] - g->first;
    }
 
-   // Signal data was non-contiguous so return the user buffer
-   return where;
+   if (unlikely(profile_res))
+      __atomic_add_fetch((p == NULL) ? &n_vec_zero_copy : &n_vec_copy, 1,
+                         __ATOMIC_RELAXED);
+
+   // Return the user buffer if the signal data was non-contiguous
+   return (p == NULL) ? (void *)base : where;
 }
 
 void _image(int64_t val, int32_t where, const char *module, struct uarray *u)
@@ -813,7 +1485,7 @@ void _image(int64_t val, int32_t where, const char *module, struct uarray *u)
       break;
 
    default:
-      fatal_at(tree_loc(t), "cannot use 'IMAGE with this type");
+      rt_fatal_at(tree_loc(t), "cannot use 'IMAGE with this type");
    }
 
    u->ptr = buf;
@@ -868,7 +1540,8 @@ void _bit_vec_op(int32_t kind, const uint8_t *left, int32_t left_len,
                  int8_t right_dir, struct uarray *u)
 {
    if ((kind != BIT_VEC_NOT) && (left_len != right_len))
-      fatal("arguments to bit vector operation are not the same length");
+      rt_fatal_at(NULL, "arguments to bit vector operation are not the "
+                  "same length");
 
    uint8_t *buf = rt_tmp_alloc(left_len);
 
@@ -939,11 +1612,12 @@ int64_t _last_event(const int32_t *nids, int32_t n)
    int64_t last = INT64_MAX;
    int offset = 0;
    while (offset < n) {
-      netgroup_t *g = &(groups[netdb_lookup(netdb, nids[offset])]);
-      if (g->last_event < now)
-         last = MIN(last, now - g->last_event);
+      groupid_t gid = netdb_lookup(netdb, nids[offset]);
+      const uint64_t last_event = infos[gid].last_event;
+      if (last_event < now)
+         last = MIN(last, now - last_event);
 
-      offset += g->length;
+      offset += groups[gid].length;
    }
 
    return last;
@@ -970,11 +1644,21 @@ void _file_open(int8_t *status, void **_fp, uint8_t *name_bytes,
                 int32_t name_len, int8_t mode)
 {
    FILE **fp = (FILE **)_fp;
+
+   rt_serial_begin();
+
    if (*fp != NULL) {
       if (status != NULL) {
          *status = 1;   // STATUS_ERROR
+         rt_serial_end();
          return;
       }
+      else if (unlikely(this_thread != NULL)) {
+         // Writes to the old file are deferred so the close must be too
+         deferred_t *d = rt_defer(D_FILE_CLOSE, NULL, 0);
+         d->fp = *fp;
+         *fp = NULL;
+      }
       else
          // This is to support closing a file implicitly when the
          // design is reset
@@ -1002,9 +1686,13 @@ void _file_open(int8_t *status, void **_fp, uint8_t *name_bytes,
    else
       *fp = fopen(fname, mode_str[mode]);
 
+   const int open_errno = errno;
+   rt_serial_end();
+
    if (*fp == NULL) {
+      errno = open_errno;
       if (status == NULL)
-         fatal_errno("failed to open %s", fname);
+         rt_fatal_at(NULL, "failed to open %s: %s", fname, strerror(errno));
       else {
          switch (errno) {
          case ENOENT:
@@ -1014,7 +1702,7 @@ void _file_open(int8_t *status, void **_fp, uint8_t *name_bytes,
             *status = 3;   // MODE_ERROR
             break;
          default:
-            fatal_errno("%s", fname);
+            rt_fatal_at(NULL, "%s: %s", fname, strerror(errno));
          }
       }
    }
@@ -1028,6 +1716,19 @@ void _file_write(void **_fp, uint8_t *data, int32_t len)
 
    TRACE("_file_write fp=%p data=%p len=%d", fp, data, len);
 
+   if (unlikely(this_thread != NULL)) {
+      // Deferred so the output is ordered with reports from the same
+      // and earlier processes
+      deferred_t *d = rt_defer(D_FILE_WRITE, data, len);
+      d->n  = len;
+      d->fp = *fp;
+
+      if (*fp == NULL)
+         rt_abandon_job();
+
+      return;
+   }
+
    if (*fp == NULL)
       fatal("write to closed file");
 
@@ -1041,11 +1742,15 @@ void _file_read(void **_fp, uint8_t *data, int32_t len, int32_t *out)
    TRACE("_file_read fp=%p data=%p len=%d", fp, data, len);
 
    if (*fp == NULL)
-      fatal("read from closed file");
+      rt_fatal_at(NULL, "read from closed file");
+
+   rt_serial_begin();
 
    size_t n = fread(data, 1, len, *fp);
    if (out != NULL)
       *out = n;
+
+   rt_serial_end();
 }
 
 void _file_close(void **_fp)
@@ -1054,6 +1759,17 @@ void _file_close(void **_fp)
 
    TRACE("_file_close fp=%p", fp);
 
+   if (unlikely(this_thread != NULL)) {
+      deferred_t *d = rt_defer(D_FILE_CLOSE, NULL, 0);
+      d->fp = *fp;
+
+      if (*fp == NULL)
+         rt_abandon_job();
+
+      *fp = NULL;
+      return;
+   }
+
    if (*fp == NULL)
       fatal("attempt to close already closed file");
 
@@ -1066,72 +1782,756 @@ int8_t _endfile(void *_f)
    FILE *f = _f;
 
    if (f == NULL)
-      fatal("ENDFILE called on closed file");
+      rt_fatal_at(NULL, "ENDFILE called on closed file");
+
+   rt_serial_begin();
 
+   int8_t eof = 0;
    int c = fgetc(f);
    if (c == EOF)
-      return 1;
-   else {
+      eof = 1;
+   else
       ungetc(c, f);
-      return 0;
-   }
+
+   rt_serial_end();
+   return eof;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-// Simulation kernel
+// Binary trace
 
-static void _tracef(const char *fmt, ...)
+static void rt_trace_close(void)
 {
-   va_list ap;
-   va_start(ap, fmt);
+   if (trace_hdr == NULL)
+      return;
 
-   char buf[64];
-   if (iteration < 0)
-      fprintf(stderr, "TRACE (init): ");
-   else
-      fprintf(stderr, "TRACE %s+%d: ",
-              fmt_time_r(buf, sizeof(buf), now), iteration);
-   vfprintf(stderr, fmt, ap);
-   fprintf(stderr, "\n");
+   if (msync(trace_hdr, trace_map_sz, MS_SYNC) != 0)
+      warnf("msync: %s", strerror(errno));
 
-   va_end(ap);
+   munmap(trace_hdr, trace_map_sz);
+   trace_hdr  = NULL;
+   trace_recs = NULL;
 }
 
-static void deltaq_insert(event_t *e)
+static void rt_trace_open(const char *file, uint64_t records)
 {
-   if (e->when == now) {
-      event_t **chain = (e->kind == E_DRIVER) ? &delta_driver : &delta_proc;
-      e->delta_chain = *chain;
-      *chain = e;
-   }
-   else {
-      e->delta_chain = NULL;
-      heap_insert(eventq_heap, heap_key(e->when, e->kind), e);
-   }
-}
+   // Records are written directly into a shared mapping of the file so
+   // everything up to the last record survives the process crashing
 
-static void deltaq_insert_proc(uint64_t delta, rt_proc_t *wake)
-{
-   event_t *e = rt_alloc(event_stack);
-   e->when       = now + delta;
-   e->kind       = E_PROCESS;
-   e->proc       = wake;
-   e->wakeup_gen = wake->wakeup_gen;
+   rt_trace_close();
 
-   deltaq_insert(e);
-}
+   const size_t ngroups = netdb_size(netdb);
+   LOCAL_TEXT_BUF names = tb_new();
+   for (size_t i = 0; i < n_procs; i++)
+      tb_printf(names, "%s\n", istr(tree_ident(procs[i].source)));
+   for (size_t i = 0; i < ngroups; i++) {
+      if (infos[i].sig_decl != NULL)
+         tb_printf(names, "%s\n", fmt_group(&(groups[i])));
+      else
+         tb_printf(names, "\n");
+   }
+
+   const size_t names_size = strlen(tb_get(names));
+   const size_t rec_offset =
+      (sizeof(rt_trace_hdr_t) + names_size + 63) & ~63;
+
+   // Round up so the ring index is a mask rather than a division
+   uint64_t capacity = 1;
+   while (capacity < records)
+      capacity <<= 1;
+
+   trace_map_sz = rec_offset + capacity * sizeof(rt_trace_rec_t);
+
+   int fd = open(file, O_RDWR | O_CREAT | O_TRUNC, 0644);
+   if (fd < 0)
+      fatal_errno("failed to create %s", file);
+
+   if (ftruncate(fd, trace_map_sz) != 0)
+      fatal_errno("failed to resize %s", file);
+
+   void *map = mmap(NULL, trace_map_sz, PROT_READ | PROT_WRITE,
+                    MAP_SHARED, fd, 0);
+   if (map == MAP_FAILED)
+      fatal_errno("mmap");
+
+   close(fd);
+
+   trace_hdr  = map;
+   trace_recs = (rt_trace_rec_t *)((uint8_t *)map + rec_offset);
+
+   trace_hdr->magic      = TRACE_MAGIC;
+   trace_hdr->rec_size   = sizeof(rt_trace_rec_t);
+   trace_hdr->n_procs    = n_procs;
+   trace_hdr->n_groups   = ngroups;
+   trace_hdr->names_size = names_size;
+   trace_hdr->rec_offset = rec_offset;
+   trace_hdr->capacity   = capacity;
+   trace_hdr->head       = 0;
+
+   memcpy(trace_hdr + 1, tb_get(names), names_size);
+}
+
+static void rt_trace_rec(rt_trace_kind_t kind, uint32_t id, uint32_t arg)
+{
+   // Processes may run concurrently on worker threads so the slot is
+   // claimed atomically but the record itself is written without locks
+
+   const uint64_t n =
+      __atomic_fetch_add(&(trace_hdr->head), 1, __ATOMIC_RELAXED);
+
+   rt_trace_rec_t *r = &(trace_recs[n & (trace_hdr->capacity - 1)]);
+   r->when  = now;
+   r->delta = MAX(iteration, 0);
+   r->id    = id;
+   r->arg   = arg;
+   r->kind  = kind;
+}
+
+void rt_trace_dump(const char *file)
+{
+   int fd = open(file, O_RDONLY);
+   if (fd < 0)
+      fatal_errno("failed to open %s", file);
+
+   struct stat st;
+   if (fstat(fd, &st) != 0)
+      fatal_errno("stat: %s", file);
+
+   if (st.st_size < sizeof(rt_trace_hdr_t))
+      fatal("%s is not a trace file", file);
+
+   void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   if (map == MAP_FAILED)
+      fatal_errno("mmap");
+
+   close(fd);
+
+   const rt_trace_hdr_t *hdr = map;
+   if (hdr->magic != TRACE_MAGIC || hdr->rec_size != sizeof(rt_trace_rec_t))
+      fatal("%s is not a trace file or was written by a different version",
+            file);
+   else if (hdr->rec_offset + hdr->capacity * hdr->rec_size > st.st_size)
+      fatal("%s is truncated", file);
+
+   const size_t nnames = hdr->n_procs + hdr->n_groups;
+   char *names = xmalloc(hdr->names_size + 1);
+   memcpy(names, hdr + 1, hdr->names_size);
+   names[hdr->names_size] = '\0';
+
+   const char **name_tab = xcalloc(nnames * sizeof(const char *));
+   char *p = names;
+   for (size_t i = 0; i < nnames && *p != '\0'; i++) {
+      name_tab[i] = p;
+      if ((p = strchr(p, '\n')) == NULL)
+         break;
+      *p++ = '\0';
+   }
+
+   const char **proc_names = name_tab;
+   const char **group_names = name_tab + hdr->n_procs;
+
+#define PROC_NAME(id) \
+   (((id) < hdr->n_procs && proc_names[(id)]) ? proc_names[(id)] : "?")
+#define GROUP_NAME(id) \
+   (((id) < hdr->n_groups && group_names[(id)]) ? group_names[(id)] : "?")
+
+   static const char *kind_names[] = {
+      "run", "wakeup", "sched", "update", "event"
+   };
+
+   const uint64_t head = hdr->head;
+   const uint64_t first = head > hdr->capacity ? head - hdr->capacity : 0;
+
+   printf("%"PRIu64" records", head - first);
+   if (first > 0)
+      printf(" (%"PRIu64" earlier records overwritten)", first);
+   printf("\n");
+
+   const rt_trace_rec_t *recs =
+      (const rt_trace_rec_t *)((const uint8_t *)map + hdr->rec_offset);
+
+   for (uint64_t n = first; n < head; n++) {
+      const rt_trace_rec_t *r = &(recs[n & (hdr->capacity - 1)]);
+
+      char tbuf[64];
+      printf("%14s+%-4u ", fmt_time_r(tbuf, sizeof(tbuf), r->when),
+             r->delta);
+
+      if (r->kind >= TRACE_LAST_KIND) {
+         printf("??? %u %u\n", r->id, r->arg);
+         continue;
+      }
+
+      printf("%-7s", kind_names[r->kind]);
+
+      switch (r->kind) {
+      case TRACE_RUN:
+      case TRACE_WAKEUP:
+         printf("%s\n", PROC_NAME(r->id));
+         break;
+      case TRACE_SCHED:
+         printf("%s from %s\n", GROUP_NAME(r->id),
+                r->arg == UINT32_MAX ? "kernel" : PROC_NAME(r->arg));
+         break;
+      case TRACE_UPDATE:
+      case TRACE_EVENT:
+         printf("%s\n", GROUP_NAME(r->id));
+         break;
+      }
+   }
+
+#undef PROC_NAME
+#undef GROUP_NAME
+
+   free(name_tab);
+   free(names);
+   munmap(map, st.st_size);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Sampling profiler
+
+static int rt_jit_sym_cmp(const void *a, const void *b)
+{
+   const uintptr_t sa = ((const rt_jit_sym_t *)a)->start;
+   const uintptr_t sb = ((const rt_jit_sym_t *)b)->start;
+   return (sa > sb) - (sa < sb);
+}
+
+static void rt_jit_sym_size(uintptr_t addr, size_t size, void *context)
+{
+   const rt_jit_sym_t key = { .start = addr };
+   rt_jit_sym_t *js = bsearch(&key, jit_syms, n_jit_syms,
+                              sizeof(rt_jit_sym_t), rt_jit_sym_cmp);
+   if (js != NULL)
+      js->size = size;
+}
+
+static int rt_line_cmp(const void *a, const void *b)
+{
+   const uintptr_t la = ((const rt_line_t *)a)->addr;
+   const uintptr_t lb = ((const rt_line_t *)b)->addr;
+   return (la > lb) - (la < lb);
+}
+
+static void rt_build_jit_lines(void)
+{
+   // Designs elaborated with --line-table have a table of the address
+   // of the first instruction of each statement in every process
+
+   size_t alloc = 0;
+   for (size_t i = 0; i < n_jit_syms; i++) {
+      const rt_jit_sym_t *js = &(jit_syms[i]);
+      const char *name = istr(tree_ident(procs[js->proc].source));
+      char *tname LOCAL = xasprintf("%s__lines", name);
+      const int64_t *table = jit_var_ptr(tname, false);
+      if (table == NULL)
+         continue;
+
+      const int64_t count = table[0];
+      if (n_jit_lines + count > alloc) {
+         alloc = MAX(alloc * 2, n_jit_lines + count);
+         jit_lines = xrealloc(jit_lines, alloc * sizeof(rt_line_t));
+      }
+
+      for (int64_t j = 0; j < count; j++) {
+         const uintptr_t addr = table[1 + (j * 2)];
+         if (addr < js->start || addr >= js->start + js->size)
+            continue;   // Block was removed by the optimiser
+
+         rt_line_t *l = &(jit_lines[n_jit_lines++]);
+         l->addr   = addr;
+         l->fn_end = js->start + js->size;
+         l->line   = table[2 + (j * 2)];
+         l->proc   = js->proc;
+      }
+   }
+
+   qsort(jit_lines, n_jit_lines, sizeof(rt_line_t), rt_line_cmp);
+}
+
+static const rt_line_t *rt_sample_line(uintptr_t pc)
+{
+   // The statement is the one whose code starts closest before the PC
+   // in the same function: blocks shared by several statements or
+   // moved by the optimiser make this approximate
+
+   size_t low = 0, high = n_jit_lines;
+   while (low < high) {
+      const size_t mid = (low + high) / 2;
+      if (jit_lines[mid].addr <= pc)
+         low = mid + 1;
+      else
+         high = mid;
+   }
+
+   if (low == 0 || pc >= jit_lines[low - 1].fn_end)
+      return NULL;
+
+   return &(jit_lines[low - 1]);
+}
+
+static void rt_build_jit_syms(void)
+{
+   // Sizes come from the symbol tables of the object files loaded by
+   // the JIT where available and are otherwise estimated from the start
+   // of the next process function: this is only used to name samples
+   // and for the perf map
+
+   if (jit_syms != NULL)
+      return;
+
+   jit_syms = xmalloc(MAX(n_procs, 1) * sizeof(rt_jit_sym_t));
+   n_jit_syms = 0;
+
+   for (size_t i = 0; i < n_procs; i++) {
+      Dl_info di;
+      if (dladdr(procs[i].proc_fn, &di) != 0)
+         continue;   // Native code from a shared library
+
+      rt_jit_sym_t *js = &(jit_syms[n_jit_syms++]);
+      js->start = (uintptr_t)procs[i].proc_fn;
+      js->size  = 0;
+      js->proc  = i;
+   }
+
+   qsort(jit_syms, n_jit_syms, sizeof(rt_jit_sym_t), rt_jit_sym_cmp);
+
+   jit_walk_fn_symbols(rt_jit_sym_size, NULL);
+
+   for (size_t i = 0; i < n_jit_syms; i++) {
+      if (jit_syms[i].size > 0)
+         continue;
+      else if (i + 1 < n_jit_syms)
+         jit_syms[i].size = MIN(JIT_SYM_MAX_SZ,
+                                jit_syms[i + 1].start - jit_syms[i].start);
+      else
+         jit_syms[i].size = JIT_SYM_MAX_SZ;
+   }
+
+   rt_build_jit_lines();
+}
+
+static void rt_write_perf_map(void)
+{
+   // See tools/perf/Documentation/jit-interface.txt in the Linux tree
+
+   rt_build_jit_syms();
+
+   char *fname LOCAL = xasprintf("/tmp/perf-%d.map", getpid());
+   FILE *f = fopen(fname, "w");
+   if (f == NULL)
+      fatal_errno("failed to create %s", fname);
+
+   for (size_t i = 0; i < n_jit_syms; i++)
+      fprintf(f, "%"PRIxPTR" %zx %s\n", jit_syms[i].start, jit_syms[i].size,
+              istr(tree_ident(procs[jit_syms[i].proc].source)));
+
+   fclose(f);
+}
+
+static void rt_sample_handler(int sig, siginfo_t *info, void *context)
+{
+   const uint64_t n = __atomic_fetch_add(&n_samples, 1, __ATOMIC_RELAXED);
+   if (n >= SAMPLE_MAX)
+      return;
+
+#ifdef PC_FROM_UCONTEXT
+   samples[n].pc = ((ucontext_t *)context)->PC_FROM_UCONTEXT;
+#else
+   samples[n].pc = 0;
+#endif
+
+   rt_proc_t *proc = sample_proc;
+   samples[n].proc = (proc == NULL) ? 0 : proc - procs + 1;
+}
+
+static void rt_arm_sampling(void)
+{
+   struct itimerval it = {
+      .it_interval = { 0, 1000000 / SAMPLE_HZ },
+      .it_value    = { 0, 1000000 / SAMPLE_HZ }
+   };
+   if (setitimer(ITIMER_PROF, &it, NULL) != 0)
+      fatal_errno("setitimer");
+}
+
+static void rt_start_sampling(void)
+{
+   samples = xmalloc(SAMPLE_MAX * sizeof(rt_sample_t));
+   n_samples = 0;
+
+   struct sigaction sa;
+   sa.sa_sigaction = rt_sample_handler;
+   sigemptyset(&sa.sa_mask);
+   sa.sa_flags = SA_RESTART | SA_SIGINFO;
+
+   sigaction(SIGPROF, &sa, NULL);
+
+   rt_arm_sampling();
+}
+
+static void rt_stop_sampling(void)
+{
+   struct itimerval it = {};
+   setitimer(ITIMER_PROF, &it, NULL);
+
+   // A signal may already be pending and the default action for
+   // SIGPROF is to terminate the process
+   signal(SIGPROF, SIG_IGN);
+}
+
+static const char *rt_sample_symbol(uintptr_t pc, hash_t *cache)
+{
+   if (pc == 0)
+      return "[unknown]";
+
+   const char *name = hash_get(cache, (void *)pc);
+   if (name != NULL)
+      return name;
+
+   Dl_info di;
+#ifdef __GLIBC__
+   const ElfW(Sym) *sym = NULL;
+   const bool found =
+      dladdr1((void *)pc, &di, (void **)&sym, RTLD_DL_SYMENT) != 0;
+
+   // Static functions are not in the dynamic symbol table and dladdr
+   // returns the nearest exported symbol before them instead
+   if (found && sym != NULL && di.dli_sname != NULL
+       && pc < (uintptr_t)di.dli_saddr + sym->st_size)
+      name = di.dli_sname;
+#else
+   const bool found = dladdr((void *)pc, &di) != 0;
+   if (found && di.dli_sname != NULL)
+      name = di.dli_sname;
+#endif
+   else if (found) {
+      const char *slash = strrchr(di.dli_fname, '/');
+      char *tmp LOCAL = xasprintf("[%s]", slash ? slash + 1 : di.dli_fname);
+      name = istr(ident_new(tmp));
+   }
+   else {
+      name = "[jit]";
+      for (size_t i = 0; i < n_jit_syms; i++) {
+         const rt_jit_sym_t *js = &(jit_syms[i]);
+         if (pc >= js->start && pc < js->start + js->size) {
+            name = istr(tree_ident(procs[js->proc].source));
+            break;
+         }
+      }
+   }
+
+   hash_put(cache, (void *)pc, (void *)name);
+   return name;
+}
 
-static void deltaq_insert_driver(uint64_t delta, netgroup_t *group,
-                                 rt_proc_t *driver)
+static int rt_sample_stack_cmp(const void *a, const void *b)
+{
+   const rt_sample_t *sa = a, *sb = b;
+   if (sa->proc != sb->proc)
+      return (sa->proc > sb->proc) - (sa->proc < sb->proc);
+   else
+      return (sa->pc > sb->pc) - (sa->pc < sb->pc);
+}
+
+typedef struct {
+   const char *name;
+   const char *file;
+   uint64_t    count;
+   unsigned    proc;
+   unsigned    line;
+} rt_sample_count_t;
+
+static int rt_sample_count_cmp(const void *a, const void *b)
+{
+   const uint64_t na = ((const rt_sample_count_t *)a)->count;
+   const uint64_t nb = ((const rt_sample_count_t *)b)->count;
+   return (na < nb) - (na > nb);
+}
+
+static int rt_sample_name_cmp(const void *a, const void *b)
+{
+   const rt_sample_count_t *sa = a, *sb = b;
+   if (sa->proc != sb->proc)
+      return (sa->proc > sb->proc) - (sa->proc < sb->proc);
+   else if (sa->name != sb->name)
+      return (sa->name > sb->name) - (sa->name < sb->name);
+   else if (sa->file != sb->file)
+      return (sa->file > sb->file) - (sa->file < sb->file);
+   else
+      return (sa->line > sb->line) - (sa->line < sb->line);
+}
+
+static void rt_folded_frames(FILE *f, const char *path)
+{
+   // Hierarchical names such as :top:uut:proc become top;uut;proc
+   for (const char *p = path; *p != '\0'; p++) {
+      if (*p == ':') {
+         if (p != path)
+            fputc(';', f);
+      }
+      else
+         fputc(*p, f);
+   }
+}
+
+static void rt_sample_print(void)
+{
+   // Each sample is attributed to the process running on the thread
+   // that was interrupted, or to the kernel, and to the function
+   // containing the sampled PC. If the design was elaborated with
+   // --line-table then samples in JIT code are also attributed to the
+   // statement whose code starts closest before the PC
+
+   const int max_rows = 20;
+
+   const uint64_t nkept = MIN(n_samples, SAMPLE_MAX);
+   if (n_samples > SAMPLE_MAX)
+      warnf("sample buffer full: %"PRIu64" samples dropped",
+            n_samples - SAMPLE_MAX);
+
+   rt_build_jit_syms();
+
+   qsort(samples, nkept, sizeof(rt_sample_t), rt_sample_stack_cmp);
+
+   // Group samples with the same process, symbol, and line: several
+   // PCs in the same statement become adjacent once sorted by name
+   hash_t *cache = hash_new(4096, true);
+   rt_sample_count_t *counts = xmalloc(MAX(nkept, 1) * sizeof(*counts));
+   uint64_t *proc_counts = xcalloc((n_procs + 1) * sizeof(uint64_t));
+   size_t ncounts = 0, nlines = 0;
+   for (uint64_t i = 0; i < nkept; i++) {
+      const char *name = rt_sample_symbol(samples[i].pc, cache);
+
+      const char *file = NULL;
+      unsigned line = 0;
+      const rt_line_t *l = rt_sample_line(samples[i].pc);
+      if (l != NULL) {
+         file = tree_loc(procs[l->proc].source)->file ?: "?";
+         line = l->line;
+      }
+
+      if (ncounts > 0 && counts[ncounts - 1].proc == samples[i].proc
+          && counts[ncounts - 1].name == name
+          && counts[ncounts - 1].file == file
+          && counts[ncounts - 1].line == line)
+         counts[ncounts - 1].count++;
+      else {
+         counts[ncounts].name  = name;
+         counts[ncounts].file  = file;
+         counts[ncounts].line  = line;
+         counts[ncounts].proc  = samples[i].proc;
+         counts[ncounts].count = 1;
+         ncounts++;
+         if (line > 0)
+            nlines++;
+      }
+      proc_counts[samples[i].proc]++;
+   }
+
+   hash_free(cache);
+
+   qsort(counts, ncounts, sizeof(rt_sample_count_t), rt_sample_name_cmp);
+
+   const char *fname = opt_get_str("rt-sample-file");
+   FILE *f = fopen(fname, "w");
+   if (f == NULL)
+      fatal_errno("failed to create %s", fname);
+
+   for (size_t i = 0; i < ncounts; ) {
+      const rt_sample_count_t *c = &(counts[i]);
+      uint64_t count = c->count;
+      for (i++; i < ncounts && counts[i].proc == c->proc
+              && counts[i].name == c->name && counts[i].file == c->file
+              && counts[i].line == c->line; i++)
+         count += counts[i].count;
+
+      if (c->proc == 0)
+         fprintf(f, "[kernel]");
+      else
+         rt_folded_frames(f, istr(tree_ident(procs[c->proc - 1].source)));
+
+      // Samples in the process function itself have no extra frame
+      if (c->proc == 0
+          || c->name != istr(tree_ident(procs[c->proc - 1].source)))
+         fprintf(f, ";%s", c->name);
+
+      if (c->line > 0)
+         fprintf(f, ";%s:%u", c->file, c->line);
+
+      fprintf(f, " %"PRIu64"\n", count);
+   }
+
+   fclose(f);
+
+   notef("sampling profile: %"PRIu64" samples at %dHz", nkept, SAMPLE_HZ);
+
+   // Flat profile by process including kernel calls made on its behalf
+   rt_sample_count_t *by_proc = xmalloc((n_procs + 1) * sizeof(*by_proc));
+   for (size_t i = 0; i <= n_procs; i++) {
+      by_proc[i].name  = NULL;
+      by_proc[i].proc  = i;
+      by_proc[i].count = proc_counts[i];
+   }
+
+   qsort(by_proc, n_procs + 1, sizeof(rt_sample_count_t),
+         rt_sample_count_cmp);
+
+   printf("%6s %10s  %s\n", "%time", "samples", "process");
+   for (size_t i = 0; i <= n_procs && i < max_rows; i++) {
+      const rt_sample_count_t *c = &(by_proc[i]);
+      if (c->count == 0)
+         break;
+
+      printf("%5.1f%% %10"PRIu64"  ", (100.0 * c->count) / nkept, c->count);
+      if (c->proc == 0)
+         printf("[kernel]\n");
+      else {
+         tree_t source = procs[c->proc - 1].source;
+         const loc_t *loc = tree_loc(source);
+         printf("%s (%s:%d)\n", istr(tree_ident(source)),
+                loc->file ?: "?", loc->first_line);
+      }
+   }
+
+   // Flat profile by source line regardless of process
+   if (nlines > 0) {
+      rt_sample_count_t *by_line = xmalloc(nlines * sizeof(*by_line));
+      size_t nby_line = 0;
+      for (size_t i = 0; i < ncounts; i++) {
+         if (counts[i].line == 0)
+            continue;
+
+         by_line[nby_line] = counts[i];
+         by_line[nby_line].proc = 0;
+         by_line[nby_line].name = NULL;
+         nby_line++;
+      }
+
+      qsort(by_line, nby_line, sizeof(rt_sample_count_t),
+            rt_sample_name_cmp);
+
+      size_t nmerged = 0;
+      for (size_t i = 0; i < nby_line; i++) {
+         if (nmerged > 0 && by_line[nmerged - 1].file == by_line[i].file
+             && by_line[nmerged - 1].line == by_line[i].line)
+            by_line[nmerged - 1].count += by_line[i].count;
+         else
+            by_line[nmerged++] = by_line[i];
+      }
+
+      qsort(by_line, nmerged, sizeof(rt_sample_count_t),
+            rt_sample_count_cmp);
+
+      printf("\n%6s %10s  %s\n", "%time", "samples", "line");
+      for (size_t i = 0; i < nmerged && i < max_rows; i++)
+         printf("%5.1f%% %10"PRIu64"  %s:%u\n",
+                (100.0 * by_line[i].count) / nkept, by_line[i].count,
+                by_line[i].file, by_line[i].line);
+
+      free(by_line);
+   }
+
+   // Flat profile by function regardless of process
+   for (size_t i = 0; i < ncounts; i++) {
+      counts[i].proc = 0;
+      counts[i].file = NULL;
+      counts[i].line = 0;
+   }
+   qsort(counts, ncounts, sizeof(rt_sample_count_t), rt_sample_name_cmp);
+
+   size_t nfuncs = 0;
+   for (size_t i = 0; i < ncounts; i++) {
+      if (nfuncs > 0 && counts[nfuncs - 1].name == counts[i].name)
+         counts[nfuncs - 1].count += counts[i].count;
+      else
+         counts[nfuncs++] = counts[i];
+   }
+
+   qsort(counts, nfuncs, sizeof(rt_sample_count_t), rt_sample_count_cmp);
+
+   printf("\n%6s %10s  %s\n", "%time", "samples", "function");
+   for (size_t i = 0; i < nfuncs && i < max_rows; i++)
+      printf("%5.1f%% %10"PRIu64"  %s\n", (100.0 * counts[i].count) / nkept,
+             counts[i].count, counts[i].name);
+
+   free(by_proc);
+   free(proc_counts);
+   free(counts);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Simulation kernel
+
+static void _tracef(const char *fmt, ...)
+{
+   va_list ap;
+   va_start(ap, fmt);
+
+   char buf[64];
+   if (iteration < 0)
+      fprintf(stderr, "TRACE (init): ");
+   else
+      fprintf(stderr, "TRACE %s+%d: ",
+              fmt_time_r(buf, sizeof(buf), now), iteration);
+   vfprintf(stderr, fmt, ap);
+   fprintf(stderr, "\n");
+
+   va_end(ap);
+}
+
+static void rt_free_event(event_t *e)
+{
+   if (e->kind == E_TRANSACTION && e->txn != NULL) {
+      const size_t sz =
+         sizeof(txn_t) + e->txn->nparts * sizeof(txn_part_t);
+      rt_pool_free(value_pool, e->txn, sz);
+   }
+
+   rt_free(event_stack, e);
+}
+
+static void deltaq_insert(event_t *e)
+{
+   if (e->when == now) {
+      const bool is_driver =
+         (e->kind == E_DRIVER) || (e->kind == E_TRANSACTION);
+      event_t **chain = is_driver ? &delta_driver : &delta_proc;
+      e->delta_chain = *chain;
+      *chain = e;
+   }
+   else {
+      e->delta_chain = NULL;
+      eventq_insert(heap_key(e->when, e->kind), e);
+   }
+}
+
+static void deltaq_insert_proc(uint64_t delta, rt_proc_t *wake)
+{
+   event_t *e = rt_alloc(event_stack);
+   e->when       = now + delta;
+   e->kind       = E_PROCESS;
+   e->proc       = wake;
+   e->wakeup_gen = wake->wakeup_gen;
+
+   deltaq_insert(e);
+}
+
+static event_t *deltaq_insert_driver(uint64_t delta, netgroup_t *group,
+                                     rt_proc_t *proc, int driver)
 {
    event_t *e = rt_alloc(event_stack);
    e->when       = now + delta;
    e->kind       = E_DRIVER;
    e->group      = group;
-   e->proc       = driver;
+   e->txn        = NULL;
+   e->proc       = proc;
+   e->driver     = driver;
    e->wakeup_gen = UINT32_MAX;
 
    deltaq_insert(e);
+   return e;
 }
 
 #if TRACE_DELTAQ > 0
@@ -1142,7 +2542,13 @@ static void deltaq_walk(uint64_t key, void *user, void *context)
    fprintf(stderr, "%s\t", fmt_time(e->when));
    switch (e->kind) {
    case E_DRIVER:
-      fprintf(stderr, "driver\t %s\n", fmt_group(e->group));
+      if (e->group == NULL)
+         fprintf(stderr, "driver\t (cancelled)\n");
+      else
+         fprintf(stderr, "driver\t %s\n", fmt_group(e->group));
+      break;
+   case E_TRANSACTION:
+      fprintf(stderr, "txn\t %u groups\n", e->txn->nparts);
       break;
    case E_PROCESS:
       fprintf(stderr, "process\t %s%s\n", istr(tree_ident(e->proc->source)),
@@ -1156,15 +2562,23 @@ static void deltaq_walk(uint64_t key, void *user, void *context)
 
 static void deltaq_dump(void)
 {
-   for (event_t *e = delta_driver; e != NULL; e = e->delta_chain)
-      fprintf(stderr, "delta\tdriver\t %s\n", fmt_group(e->group));
+   for (event_t *e = delta_driver; e != NULL; e = e->delta_chain) {
+      if (e->kind == E_TRANSACTION)
+         fprintf(stderr, "delta\ttxn\t %u groups\n", e->txn->nparts);
+      else
+         fprintf(stderr, "delta\tdriver\t %s\n",
+                 (e->group == NULL) ? "(cancelled)" : fmt_group(e->group));
+   }
 
    for (event_t *e = delta_proc; e != NULL; e = e->delta_chain)
       fprintf(stderr, "delta\tprocess\t %s%s\n",
               istr(tree_ident(e->proc->source)),
               (e->wakeup_gen == e->proc->wakeup_gen) ? "" : " (stale)");
 
-   heap_walk(eventq_heap, deltaq_walk, NULL);
+   if (eventq_kind == EVENTQ_WHEEL)
+      wheel_walk(eventq_wheel, deltaq_walk, NULL);
+   else
+      heap_walk(eventq_heap, deltaq_walk, NULL);
 }
 #endif
 
@@ -1180,8 +2594,10 @@ static res_memo_t *rt_memo_resolution_fn(type_t type, resolution_fn_t fn)
       type = type_elem(type);
 
    memo = xmalloc(sizeof(res_memo_t));
-   memo->fn    = fn;
-   memo->flags = 0;
+   memo->fn      = fn;
+   memo->flags   = 0;
+   memo->tabmask = NULL;
+   memo->nlits   = 0;
 
    hash_put(res_memo_hash, fn, memo);
 
@@ -1228,10 +2644,66 @@ static res_memo_t *rt_memo_resolution_fn(type_t type, resolution_fn_t fn)
       identity = identity && (memo->tab1[i] == i);
    }
 
+   // Check whether the result with three or more drivers depends only
+   // on the number of drivers with each value in which case it can be
+   // updated incrementally: the function must be commutative and
+   // associative and calls with more than two arguments must be the
+   // same as folding the two value table
+
+   bool commutative = true, associative = true, idempotent = true;
+   for (int i = 0; i < nlits; i++) {
+      idempotent = idempotent && (memo->tab2[i][i] == i);
+      for (int j = 0; j < nlits; j++)
+         commutative = commutative && (memo->tab2[i][j] == memo->tab2[j][i]);
+   }
+
+   for (int i = 0; (i < nlits) && commutative && associative; i++) {
+      for (int j = 0; (j < nlits) && associative; j++) {
+         const int8_t ij = memo->tab2[i][j];
+         if ((ij < 0) || (ij >= nlits)) {
+            associative = false;
+            break;
+         }
+
+         for (int k = 0; (k < nlits) && associative; k++) {
+            const int8_t jk = memo->tab2[j][k];
+            if ((jk < 0) || (jk >= nlits))
+               associative = false;
+            else {
+               int8_t args[3] = { i, j, k };
+               const int8_t ijk = memo->tab2[ij][k];
+               associative = (ijk == memo->tab2[i][jk])
+                  && (ijk == (int8_t)(*fn)(args, 3));
+            }
+         }
+      }
+   }
+
    if (init_side_effect != SIDE_EFFECT_OCCURRED) {
       memo->flags |= R_MEMO;
       if (identity)
          memo->flags |= R_IDENT;
+      if (commutative)
+         memo->flags |= R_COMM;
+      if (commutative && associative)
+         memo->flags |= R_ASSOC;
+      if (idempotent)
+         memo->flags |= R_IDEMP;
+   }
+
+   memo->nlits = nlits;
+
+   if ((memo->flags & (R_INCREMENTAL | R_IDEMP)) == (R_INCREMENTAL | R_IDEMP)) {
+      // The result only depends on the set of values being driven so
+      // tabulate it for every subset
+      memo->tabmask = xmalloc(1 << nlits);
+      memo->tabmask[0] = 0;
+      for (int mask = 1; mask < (1 << nlits); mask++) {
+         const int low  = __builtin_ctz(mask);
+         const int rest = mask & (mask - 1);
+         memo->tabmask[mask] =
+            (rest == 0) ? low : memo->tab2[memo->tabmask[rest]][low];
+      }
    }
 
    return memo;
@@ -1254,43 +2726,34 @@ static void rt_global_event(rt_event_t kind)
 
 static value_t *rt_alloc_value(netgroup_t *g)
 {
-   if (g->free_values == NULL) {
-      value_t *v = xmalloc(sizeof(struct value) + (g->size * g->length));
-      v->next = NULL;
-      return v;
-   }
-   else {
-      value_t *v = g->free_values;
-      g->free_values = v->next;
-      v->next = NULL;
-      return v;
-   }
+   const size_t sz = sizeof(struct value) + (g->size * g->length);
+   value_t *v = rt_pool_alloc(value_pool, sz);
+   v->next = NULL;
+   return v;
 }
 
 static void rt_free_value(netgroup_t *g, value_t *v)
 {
-   assert(v->next == NULL);
-   v->next = g->free_values;
-   g->free_values = v;
+   const size_t sz = sizeof(struct value) + (g->size * g->length);
+   rt_pool_free(value_pool, v, sz);
 }
 
 static void *rt_tmp_alloc(size_t sz)
 {
    // Allocate sz bytes that will be freed by the active process
 
-   uint8_t *ptr = (uint8_t *)_tmp_stack + _tmp_alloc;
-   _tmp_alloc += sz;
+   uint8_t *ptr = (uint8_t *)tmp_stack.base + tmp_stack.alloc;
+   tmp_stack.alloc += sz;
    return ptr;
 }
 
-static void rt_sched_event(sens_list_t **list, netid_t first, netid_t last,
-                           rt_proc_t *proc, bool is_static)
+static void rt_sched_event(sens_list_t **list, rt_proc_t *proc,
+                           bool is_static, uint16_t edges)
 {
    // See if there is already a stale entry in the pending
    // list for this process
    sens_list_t *it = *list;
-   int count = 0;
-   for (; it != NULL; it = it->next, ++count) {
+   for (; it != NULL; it = it->next) {
       if ((it->proc == proc)
           && (it->wakeup_gen != proc->wakeup_gen))
          break;
@@ -1301,9 +2764,13 @@ static void rt_sched_event(sens_list_t **list, netid_t first, netid_t last,
       node->proc       = proc;
       node->wakeup_gen = proc->wakeup_gen;
       node->next       = *list;
-      node->first      = first;
-      node->last       = last;
-      node->reenq      = (is_static ? list : NULL);
+      node->first      = NETID_INVALID;
+      node->last       = NETID_INVALID;
+      node->reenq      = list;
+      node->inode      = NULL;
+      node->is_static  = is_static;
+      node->fanout     = false;
+      node->edges      = edges;
 
       *list = node;
    }
@@ -1311,19 +2778,102 @@ static void rt_sched_event(sens_list_t **list, netid_t first, netid_t last,
       // Reuse the stale entry
       assert(!is_static);
       it->wakeup_gen = proc->wakeup_gen;
-      it->first      = first;
-      it->last       = last;
+   }
+}
+
+static void rt_sched_global(netid_t first, netid_t last, rt_proc_t *proc,
+                            bool is_static)
+{
+   // Entries on the global pending list are indexed by net range so
+   // an event only visits the processes waiting on overlapping nets.
+   // Each process keeps its own non-static entries chained through the
+   // next field while they are in the index so stale entries can be
+   // found without searching the whole list.
+
+   sens_list_t *it = NULL;
+   if (!is_static) {
+      for (it = proc->global; it != NULL; it = it->next) {
+         if (it->wakeup_gen != proc->wakeup_gen)
+            break;
+      }
+   }
+
+   if (it == NULL) {
+      it = rt_alloc(sens_list_stack);
+      it->proc      = proc;
+      it->reenq     = NULL;
+      it->is_static = is_static;
+      it->edges     = 0;
+      it->inode     = NULL;
+
+      if (!is_static) {
+         it->next     = proc->global;
+         proc->global = it;
+      }
+      else
+         it->next = NULL;
+   }
+   else if ((it->first != first) || (it->last != last)) {
+      // Reuse the stale entry but move it to the new range
+      itree_remove(pending, it->inode);
+      it->inode = NULL;
+   }
+
+   it->wakeup_gen = proc->wakeup_gen;
+   it->first      = first;
+   it->last       = last;
+
+   if (it->inode == NULL)
+      it->inode = itree_insert(pending, first, last, it);
+}
+
+static void rt_unlink_global(sens_list_t *sl)
+{
+   // Remove an entry extracted from the global index from the owning
+   // process's chain of non-static entries
+   sl->inode = NULL;
+
+   if (sl->is_static)
+      return;
+
+   sens_list_t **it;
+   for (it = &(sl->proc->global); *it != sl; it = &((*it)->next))
+      assert(*it != NULL);
+
+   *it = sl->next;
+   sl->next = NULL;
+}
+
+static void rt_free_pending_fn(uint32_t low, uint32_t high, void *user,
+                               void *context)
+{
+   sens_list_t *sl = user;
+   rt_unlink_global(sl);
+   rt_free(sens_list_stack, sl);
+}
+
+static void rt_free_pending(void)
+{
+   if (pending != NULL) {
+      itree_extract(pending, 0, UINT32_MAX, rt_free_pending_fn, NULL);
+      itree_free(pending);
+      pending = NULL;
    }
 }
 
 #if TRACE_PENDING
+static void rt_dump_pending_fn(uint32_t low, uint32_t high, void *user,
+                               void *context)
+{
+   sens_list_t *it = user;
+   printf("%d..%d\t%s%s\n", it->first, it->last,
+          istr(tree_ident(it->proc->source)),
+          (it->wakeup_gen == it->proc->wakeup_gen) ? "" : " (stale)");
+}
+
 static void rt_dump_pending(void)
 {
-   for (struct sens_list *it = pending; it != NULL; it = it->next) {
-      printf("%d..%d\t%s%s\n", it->first, it->last,
-             istr(tree_ident(it->proc->source)),
-             (it->wakeup_gen == it->proc->wakeup_gen) ? "" : " (stale)");
-   }
+   itree_walk(pending, rt_dump_pending_fn, NULL);
 }
 #endif  // TRACE_PENDING
 
@@ -1331,25 +2881,84 @@ static void rt_reset_group(groupid_t gid, netid_t first, unsigned length)
 {
    netgroup_t *g = &(groups[gid]);
    memset(g, '\0', sizeof(netgroup_t));
-   g->first       = first;
-   g->length      = length;
-   g->last_event  = INT64_MAX;
+   g->first  = first;
+   g->length = length;
+
+   netinfo_t *info = &(infos[gid]);
+   memset(info, '\0', sizeof(netinfo_t));
+   info->last_event = INT64_MAX;
 }
 
 static void rt_free_delta_events(event_t *e)
 {
    while (e != NULL) {
       event_t *tmp = e->delta_chain;
-      rt_free(event_stack, e);
+      rt_free_event(e);
       e = tmp;
    }
 }
 
+static void rt_free_fanout(void)
+{
+   if (fanout != NULL) {
+      const size_t ngroups = netdb_size(netdb);
+      for (uint32_t i = 0; i < fanout_start[ngroups]; i++)
+         rt_free(sens_list_stack, fanout[i]);
+   }
+
+   free(fanout);
+   free(fanout_start);
+   fanout = NULL;
+   fanout_start = NULL;
+}
+
+static void rt_build_fanout(void)
+{
+   // Static sensitivity never changes after the processes have been
+   // reset so move those entries off the group pending lists into one
+   // flat array per group in compressed sparse row layout: the entries
+   // for group G are fanout[fanout_start[G]] to fanout[fanout_start[G
+   // + 1] - 1]. The pending lists are left with only dynamic waits.
+
+   const size_t ngroups = netdb_size(netdb);
+   fanout_start = xcalloc((ngroups + 1) * sizeof(uint32_t));
+
+   for (size_t i = 0; i < ngroups; i++) {
+      uint32_t count = 0;
+      for (sens_list_t *it = groups[i].pending; it != NULL; it = it->next)
+         count += it->is_static;
+      fanout_start[i + 1] = fanout_start[i] + count;
+   }
+
+   fanout = xmalloc(MAX(fanout_start[ngroups], 1) * sizeof(sens_list_t *));
+
+   for (size_t i = 0; i < ngroups; i++) {
+      uint32_t pos = fanout_start[i];
+      sens_list_t **link = &(groups[i].pending);
+      while (*link != NULL) {
+         sens_list_t *it = *link;
+         if (it->is_static) {
+            *link = it->next;
+            it->next   = NULL;
+            it->reenq  = NULL;
+            it->fanout = true;
+            fanout[pos++] = it;
+         }
+         else
+            link = &(it->next);
+      }
+      assert(pos == fanout_start[i + 1]);
+   }
+
+   TRACE("%u static fanout entries", fanout_start[ngroups]);
+}
+
 static void rt_setup(tree_t top)
 {
    now = 0;
    iteration = -1;
    active_proc = NULL;
+   n_jobs = 0;
    force_stop = false;
    can_create_delta = true;
 
@@ -1358,13 +2967,25 @@ static void rt_setup(tree_t top)
    rt_free_delta_events(delta_proc);
    rt_free_delta_events(delta_driver);
 
-   if (eventq_heap != NULL)
-      heap_free(eventq_heap);
-   eventq_heap = heap_new(512);
+   eventq_free();
+   eventq_new();
+
+   rt_free_pending();
+   pending = itree_new();
+
+   rt_free_clocks();
+   rt_free_fanout();
 
    if (netdb == NULL) {
       netdb = netdb_open(top);
-      groups = xmalloc(sizeof(struct netgroup) * netdb_size(netdb));
+
+      // Align the hot group data so each group is in one cache line
+      const size_t ngroups = netdb_size(netdb);
+      if (posix_memalign((void **)&groups, sizeof(netgroup_t),
+                         sizeof(netgroup_t) * ngroups) != 0)
+         fatal_errno("posix_memalign");
+
+      infos = xmalloc(sizeof(netinfo_t) * ngroups);
    }
 
    if (procs == NULL) {
@@ -1377,6 +2998,10 @@ static void rt_setup(tree_t top)
    netdb_walk(netdb, rt_reset_group);
 
    ident_t postponed_i = ident_new("postponed");
+   ident_t level_i     = ident_new("level");
+
+   levelise  = opt_get_int("rt-levelise");
+   max_level = 0;
 
    const int nstmts = tree_stmts(top);
    for (int i = 0; i < nstmts; i++) {
@@ -1387,7 +3012,28 @@ static void rt_setup(tree_t top)
       procs[i].proc_fn    = jit_fun_ptr(istr(tree_ident(p)), true);
       procs[i].wakeup_gen = 0;
       procs[i].postponed  = tree_attr_int(p, postponed_i, 0);
+      procs[i].armed      = true;
+      procs[i].level      = levelise ? tree_attr_int(p, level_i, 0) : 0;
+      procs[i].global     = NULL;
+
+      max_level = MAX(max_level, procs[i].level);
+   }
+
+   free(level_wake);
+   level_wake = xcalloc((max_level + 1) * sizeof(sens_list_t *));
+
+   if (opt_get_int("rt-profile")) {
+      free(profile);
+      profile = xcalloc(n_procs * sizeof(rt_profile_t));
+   }
+
+   if (opt_get_str("rt-activity-file") != NULL) {
+      free(activity);
+      activity = xcalloc(netdb_size(netdb) * sizeof(rt_activity_t));
    }
+
+   if (opt_get_int("rt-perf-map") && jit_syms == NULL)
+      rt_write_perf_map();
 }
 
 static void rt_run(struct rt_proc *proc, bool reset)
@@ -1396,116 +3042,479 @@ static void rt_run(struct rt_proc *proc, bool reset)
          istr(tree_ident(proc->source)));
 
    if (reset) {
-      _tmp_stack = global_tmp_stack;
-      _tmp_alloc = global_tmp_alloc;
+      tmp_stack.base  = global_tmp_stack;
+      tmp_stack.alloc = global_tmp_alloc;
    }
    else {
-      _tmp_stack = proc_tmp_stack;
-      _tmp_alloc = 0;
+      tmp_stack.base  = (this_thread != NULL) ? this_thread->tmp_stack
+         : proc_tmp_stack;
+      tmp_stack.alloc = 0;
    }
 
+   const uint64_t start = unlikely(profile != NULL) ? get_timestamp_ns() : 0;
+
+   if (unlikely(trace_hdr != NULL) && !reset)
+      rt_trace_rec(TRACE_RUN, proc - procs, 0);
+
+   if (unlikely(samples != NULL))
+      sample_proc = proc;
+
    active_proc = proc;
    (*proc->proc_fn)(reset ? 1 : 0);
 
+   if (unlikely(samples != NULL))
+      sample_proc = NULL;
+
+   if (this_thread == NULL)
+      rt_flush_batches();
+
+   if (unlikely(profile != NULL) && !reset) {
+      rt_profile_t *p = &(profile[proc - procs]);
+      p->activations++;
+      p->ns += get_timestamp_ns() - start;
+   }
+
    if (reset)
-      global_tmp_alloc = _tmp_alloc;
+      global_tmp_alloc = tmp_stack.alloc;
+}
+
+static void rt_push_job(rt_proc_t *proc, sens_list_t *sens)
+{
+   if (unlikely(n_jobs == jobs_alloc)) {
+      jobs_alloc = MAX(jobs_alloc * 2, 128);
+      jobs = xrealloc(jobs, jobs_alloc * sizeof(rt_job_t));
+   }
+
+   rt_job_t *job = &(jobs[n_jobs++]);
+   job->proc   = proc;
+   job->sens   = sens;
+   job->thread = NULL;
+}
+
+static void rt_job_done(rt_job_t *job)
+{
+   sens_list_t *sl = job->sens;
+   if (sl == NULL)
+      return;
+   else if (!sl->is_static)
+      rt_free(sens_list_stack, sl);
+   else if (sl->fanout)
+      sl->proc->armed = true;
+   else if (sl->reenq == NULL)
+      sl->inode = itree_insert(pending, sl->first, sl->last, sl);
+   else {
+      sl->next = *(sl->reenq);
+      *(sl->reenq) = sl;
+   }
+}
+
+static void rt_replay_job(rt_job_t *job)
+{
+   // Apply the kernel calls made by the process in the order they
+   // would have happened had it run on the main thread
+
+   rt_thread_t *t = job->thread;
+   active_proc = job->proc;
+
+   for (unsigned i = job->first_op; i < job->last_op; i++) {
+      const deferred_t *d = &(t->ops[i]);
+      uint8_t *data = t->data + d->data;
+
+      switch (d->kind) {
+      case D_SCHED_WAVEFORM:
+         _sched_waveform((void *)d->nids, data, d->n, d->after, d->reject,
+                         d->slot);
+         break;
+      case D_SCHED_EVENT:
+         _sched_event((void *)d->nids, d->n, d->flags);
+         break;
+      case D_SCHED_PROCESS:
+         _sched_process(d->after);
+         break;
+      case D_ASSERT_FAIL:
+         _assert_fail(data, d->n, d->flags, d->after, d->module);
+         break;
+      case D_ENV_STOP:
+         _nvc_env_stop(d->flags, d->n, d->after);
+         break;
+      case D_FILE_WRITE:
+         if (d->fp == NULL)
+            fatal("write to closed file");
+         fwrite(data, 1, d->n, d->fp);
+         break;
+      case D_FILE_CLOSE:
+         if (d->fp == NULL)
+            fatal("attempt to close already closed file");
+         fclose(d->fp);
+         break;
+      case D_FATAL:
+         rt_fatal_at(d->loc, "%s", (const char *)data);
+      }
+   }
+
+   rt_flush_batches();
+}
+
+static void rt_worker_run(rt_thread_t *t, rt_job_t *job)
+{
+   job->thread   = t;
+   job->first_op = t->n_ops;
+
+   if (setjmp(t->abandon) == 0)
+      rt_run(job->proc, false /* reset */);
+   else
+      sample_proc = NULL;
+
+   job->last_op = t->n_ops;
+}
+
+static void rt_worker_run_jobs(rt_thread_t *t)
+{
+   this_thread = t;
+
+   for (;;) {
+      const unsigned first =
+         __atomic_fetch_add(&next_job, JOB_CHUNK, __ATOMIC_RELAXED);
+      if (first >= n_jobs)
+         break;
+
+      const unsigned last = MIN(first + JOB_CHUNK, n_jobs);
+      for (unsigned i = first; i < last; i++)
+         rt_worker_run(t, &(jobs[i]));
+   }
+
+   this_thread = NULL;
+}
+
+static void *rt_worker_thread(void *arg)
+{
+   rt_thread_t *t = arg;
+   unsigned gen = 0;
+
+   for (;;) {
+      pthread_mutex_lock(&pool_lock);
+      while ((pool_gen == gen) && !pool_shutdown)
+         pthread_cond_wait(&pool_start, &pool_lock);
+      const bool stop = pool_shutdown;
+      gen = pool_gen;
+      pthread_mutex_unlock(&pool_lock);
+
+      if (stop)
+         return NULL;
+
+      rt_worker_run_jobs(t);
+
+      pthread_mutex_lock(&pool_lock);
+      if (--pool_active == 0)
+         pthread_cond_signal(&pool_done);
+      pthread_mutex_unlock(&pool_lock);
+   }
+}
+
+static void rt_run_parallel(void)
+{
+   for (unsigned i = 0; i < n_threads; i++) {
+      threads[i].n_ops    = 0;
+      threads[i].data_len = 0;
+   }
+
+   next_job = 0;
+
+   pthread_mutex_lock(&pool_lock);
+   pool_active = n_threads - 1;
+   pool_gen++;
+   pthread_cond_broadcast(&pool_start);
+   pthread_mutex_unlock(&pool_lock);
+
+   // The main thread takes a share of the work too
+   rt_worker_run_jobs(&(threads[0]));
+
+   pthread_mutex_lock(&pool_lock);
+   while (pool_active > 0)
+      pthread_cond_wait(&pool_done, &pool_lock);
+   pthread_mutex_unlock(&pool_lock);
+
+   for (unsigned i = 0; i < n_jobs; i++) {
+      rt_replay_job(&(jobs[i]));
+      rt_job_done(&(jobs[i]));
+   }
+}
+
+static void rt_run_jobs(void)
+{
+   // Processes resumed in the same cycle cannot observe each other's
+   // effects until the next signal update so they may run concurrently
+
+   if ((n_threads > 1) && (n_jobs >= PARALLEL_MIN_PROCS) && !trace_on)
+      rt_run_parallel();
+   else {
+      for (unsigned i = 0; i < n_jobs; i++) {
+         rt_run(jobs[i].proc, false /* reset */);
+         rt_job_done(&(jobs[i]));
+      }
+   }
+
+   n_jobs = 0;
+}
+
+static void rt_start_threads(void)
+{
+   n_threads = MAX(opt_get_int("rt-threads"), 1);
+
+   threads = xcalloc(n_threads * sizeof(rt_thread_t));
+   threads[0].tmp_stack = proc_tmp_stack;
+
+   pool_shutdown = false;
+
+   for (unsigned i = 1; i < n_threads; i++) {
+      threads[i].tmp_stack =
+         mmap_guarded(PROC_TMP_STACK_SZ, "process temp stack");
+
+      if (pthread_create(&(threads[i].thread), NULL,
+                         rt_worker_thread, &(threads[i])) != 0)
+         fatal_errno("pthread_create");
+   }
+}
+
+static void rt_stop_threads(void)
+{
+   pthread_mutex_lock(&pool_lock);
+   pool_shutdown = true;
+   pthread_cond_broadcast(&pool_start);
+   pthread_mutex_unlock(&pool_lock);
+
+   for (unsigned i = 0; i < n_threads; i++) {
+      if (i > 0)
+         pthread_join(threads[i].thread, NULL);
+      free(threads[i].ops);
+      free(threads[i].data);
+   }
+
+   free(threads);
+   threads = NULL;
+   n_threads = 0;
+
+   free(jobs);
+   jobs = NULL;
+   jobs_alloc = 0;
 }
 
 static void rt_call_module_reset(ident_t name)
 {
    char *buf = xasprintf("%s_reset", istr(name));
 
-   _tmp_stack = global_tmp_stack;
-   _tmp_alloc = global_tmp_alloc;
+   tmp_stack.base  = global_tmp_stack;
+   tmp_stack.alloc = global_tmp_alloc;
 
    void (*reset_fn)(void) = jit_fun_ptr(buf, false);
    if (reset_fn != NULL)
       (*reset_fn)();
    free(buf);
 
-   global_tmp_alloc = _tmp_alloc;
+   global_tmp_alloc = tmp_stack.alloc;
+}
+
+static int8_t rt_histogram_value(const res_memo_t *memo,
+                                 const uint16_t *counts)
+{
+   if (memo->tabmask != NULL) {
+      unsigned mask = 0;
+      for (unsigned v = 0; v < memo->nlits; v++) {
+         if (counts[v] > 0)
+            mask |= (1 << v);
+      }
+      return memo->tabmask[mask];
+   }
+   else {
+      // Fold each value with itself count times by repeated squaring
+      int r = -1;
+      for (unsigned v = 0; v < memo->nlits; v++) {
+         int base = v;
+         for (unsigned c = counts[v]; c > 0; c >>= 1) {
+            if (c & 1)
+               r = (r == -1) ? base : memo->tab2[r][base];
+            if (c > 1)
+               base = memo->tab2[base][base];
+         }
+      }
+      return r;
+   }
+}
+
+static void rt_histogram_update(netgroup_t *group, int driver,
+                                const void *values, int8_t *resolved)
+{
+   // Maintain a count of the drivers with each value for every element
+   // of the group and resolve only the elements whose driving value
+   // changed if resolved is not NULL
+
+   const res_memo_t *memo = group->resolution;
+   const unsigned nlits = memo->nlits;
+
+   if ((group->histogram == NULL) || (driver < 0)) {
+      // Count the current driving values: when building lazily for a
+      // driver update the new value is applied as a delta below
+      const size_t histsz = group->length * nlits * sizeof(uint16_t);
+      if (group->histogram == NULL)
+         group->histogram = xmalloc(histsz);
+      memset(group->histogram, '\0', histsz);
+
+      for (int i = 0; i < group->n_drivers; i++) {
+         const int8_t *p = rt_driving_value(group, &(group->drivers[i]));
+         for (int j = 0; j < group->length; j++)
+            ++(group->histogram[(j * nlits) + p[j]]);
+      }
+   }
+
+   if (driver < 0) {
+      if (resolved != NULL) {
+         for (int j = 0; j < group->length; j++)
+            resolved[j] = rt_histogram_value(memo,
+                                             group->histogram + (j * nlits));
+      }
+   }
+   else {
+      const int8_t *old = rt_driving_value(group, &(group->drivers[driver]));
+      const int8_t *new = values;
+
+      if (resolved != NULL)
+         memcpy(resolved, group->resolved, group->length);
+
+      for (int j = 0; j < group->length; j++) {
+         if (old[j] != new[j]) {
+            uint16_t *counts = group->histogram + (j * nlits);
+            --(counts[(int)old[j]]);
+            ++(counts[(int)new[j]]);
+
+            if (resolved != NULL)
+               resolved[j] = rt_histogram_value(memo, counts);
+         }
+      }
+   }
 }
 
 static int32_t rt_resolve_group(netgroup_t *group, int driver, void *values)
 {
    // Set driver to -1 for initial call to resolution function
 
+   const uint64_t start = unlikely(profile_res) ? get_timestamp_ns() : 0;
+
    const size_t valuesz = group->size * group->length;
 
-   void *resolved = NULL;
+   // If LAST_VALUE is used the new value is written to a separate
+   // buffer so the old value is still available if there is an event
+   uint8_t *resolved = group->resolved;
+   uint8_t *dst = resolved;
+   if (group->flags & NET_F_ROTATE)
+      dst = rt_group_info(group)->scratch;
+   else if (group->flags & NET_F_LAST_VALUE)
+      dst = alloca(valuesz);
+
+   const res_memo_t *memo = group->resolution;
+
+   res_path_t path;
+   bool changed;
    if (unlikely(group->flags & NET_F_FORCED)) {
-      resolved = group->forcing->data;
-   }
-   else if (group->resolution == NULL) {
-      resolved = values;
+      if ((group->histogram != NULL) && (driver >= 0))
+         rt_histogram_update(group, driver, values, NULL);
+
+      path = RES_NONE;
+      const value_t *forcing = rt_group_info(group)->forcing;
+      changed = (*resolve_copy)(dst, resolved,
+                                (uint8_t *)forcing->data, valuesz);
    }
-   else if ((group->resolution->flags & R_IDENT) && (group->n_drivers == 1)) {
-      // Resolution function behaves like identity for a single driver
-      resolved = values;
+   else if ((memo == NULL)
+            || ((memo->flags & R_IDENT) && (group->n_drivers == 1))) {
+      // Unresolved or resolution function behaves like identity for a
+      // single driver
+      path = RES_NONE;
+      changed = (*resolve_copy)(dst, resolved, values, valuesz);
    }
-   else if ((group->resolution->flags & R_MEMO) && (group->n_drivers == 1)) {
+   else if ((memo->flags & R_MEMO) && (group->n_drivers == 1)) {
       // Resolution function has been memoised so do a table lookup
-
-      resolved = alloca(valuesz);
-
-      for (int j = 0; j < group->length; j++) {
-         const int index = { ((const char *)values)[j] };
-         const int8_t r = group->resolution->tab1[index];
-         ((int8_t *)resolved)[j] = r;
-      }
+      path = RES_TABLE1;
+      changed = (*resolve_tab1)(memo->tab1, dst, resolved, values,
+                                group->length);
    }
-   else if ((group->resolution->flags & R_MEMO) && (group->n_drivers == 2)) {
+   else if ((memo->flags & R_MEMO) && (group->n_drivers == 2)) {
       // Resolution function has been memoised so do a table lookup
+      const uint8_t *p0 = rt_driving_value(group, &(group->drivers[0]));
+      const uint8_t *p1 = rt_driving_value(group, &(group->drivers[1]));
 
-      resolved = alloca(valuesz);
-
-      const char *p0 = group->drivers[0].waveforms->values->data;
-      const char *p1 = group->drivers[1].waveforms->values->data;
-
-      for (int j = 0; j < group->length; j++) {
-         int driving[2] = { p0[j], p1[j] };
-         if (likely(driver >= 0))
-            driving[driver] = ((const char *)values)[j];
+      if (driver == 0)
+         p0 = values;
+      else if (driver == 1)
+         p1 = values;
 
-         const int8_t r = group->resolution->tab2[driving[0]][driving[1]];
-         ((int8_t *)resolved)[j] = r;
-      }
-  }
+      path = RES_TABLE2;
+      changed = (*resolve_tab2)(memo->tab2, memo->nlits, dst, resolved,
+                                p0, p1, group->length);
+   }
+   else if (((memo->flags & R_INCREMENTAL) == R_INCREMENTAL)
+            && (group->size == 1)) {
+      // Result depends only on how many drivers have each value so
+      // update the counts for the driver that changed
+      uint8_t *tmp = alloca(valuesz);
+      rt_histogram_update(group, driver, values, (int8_t *)tmp);
+
+      path = RES_INCREMENTAL;
+      changed = (*resolve_copy)(dst, resolved, tmp, valuesz);
+   }
    else {
       // Must actually call resolution function in general case
 
-      resolved = alloca(valuesz);
+      uint8_t *tmp = alloca(valuesz);
 
       for (int j = 0; j < group->length; j++) {
 #define CALL_RESOLUTION_FN(type) do {                                   \
             type vals[group->n_drivers];                                \
             for (int i = 0; i < group->n_drivers; i++) {                \
-               const value_t *v = group->drivers[i].waveforms->values;  \
-               vals[i] = ((const type *)v->data)[j];                    \
+               const void *v = rt_driving_value(group,                  \
+                                                &(group->drivers[i]));  \
+               vals[i] = ((const type *)v)[j];                          \
             }                                                           \
             if (likely(driver >= 0))                                    \
                vals[driver] = ((const type *)values)[j];                \
-            type *r = (type *)resolved;                                 \
-            r[j] = (*group->resolution->fn)(vals, group->n_drivers);    \
+            type *r = (type *)tmp;                                      \
+            r[j] = (*memo->fn)(vals, group->n_drivers);                 \
          } while (0)
 
          FOR_ALL_SIZES(group->size, CALL_RESOLUTION_FN);
       }
+
+      path = RES_CALL;
+      changed = (*resolve_copy)(dst, resolved, tmp, valuesz);
    }
 
    int32_t new_flags = NET_F_ACTIVE;
-   if (memcmp(group->resolved, resolved, valuesz) != 0)
-      new_flags |= NET_F_EVENT;
 
    // LAST_VALUE is the same as the initial value when
    // there have been no events on the signal otherwise
    // only update it when there is an event
-   if (new_flags & NET_F_EVENT) {
-      if (group->flags & NET_F_LAST_VALUE)
-         memcpy(group->last_value, group->resolved, valuesz);
-      memcpy(group->resolved, resolved, valuesz);
+   if (changed) {
+      new_flags |= NET_F_EVENT;
 
-      group->last_event = now;
+      netinfo_t *info = rt_group_info(group);
+
+      if (group->flags & NET_F_ROTATE) {
+         info->scratch     = group->last_value;
+         group->last_value = resolved;
+         group->resolved   = dst;
+
+         if (info->shadow != NULL)
+            *(info->shadow) = dst;
+      }
+      else if (dst != resolved) {
+         memcpy(group->last_value, resolved, valuesz);
+         memcpy(resolved, dst, valuesz);
+      }
+
+      info->last_event = now;
+   }
+
+   if (unlikely(profile_res)) {
+      res_stats[path].calls++;
+      res_stats[path].ns += get_timestamp_ns() - start;
    }
 
    return new_flags;
@@ -1515,11 +3524,86 @@ static void rt_group_inital(groupid_t gid, netid_t first, unsigned length)
 {
    netgroup_t *g = &(groups[gid]);
    if ((g->n_drivers == 1) && (g->resolution == NULL))
-      rt_resolve_group(g, -1, g->drivers[0].waveforms->values->data);
+      rt_resolve_group(g, -1, rt_driving_value(g, &(g->drivers[0])));
    else if (g->n_drivers > 0)
       rt_resolve_group(g, -1, g->resolved);
 }
 
+static void rt_build_arena(void)
+{
+   // Move the values of all groups into a single arena ordered by net
+   // ID so any contiguous range of nets is contiguous in memory. Groups
+   // with rotating buffers are left where they are.
+
+   free(arena);
+
+   size_t total = 0;
+   netid_t nid = 0;
+   while (nid < netdb->nnets) {
+      const groupid_t gid = netdb_lookup(netdb, nid);
+      if (gid == GROUPID_INVALID) {
+         nid++;
+         continue;
+      }
+
+      const netgroup_t *g = &(groups[gid]);
+      if ((g->resolved != NULL) && !(g->flags & NET_F_ROTATE))
+         total += g->length * g->size;
+
+      nid = g->first + g->length;
+   }
+
+   arena_size = total;
+   arena = xmalloc(MAX(total * 2, 1));
+
+   // Walk backwards so the group that owns the memory for a signal is
+   // visited after the others that point into the same block
+   uint8_t *resolved = arena + total;
+   uint8_t *last = arena + (total * 2);
+   while (nid > 0) {
+      const groupid_t gid = netdb_lookup(netdb, nid - 1);
+      if (gid == GROUPID_INVALID) {
+         nid--;
+         continue;
+      }
+
+      netgroup_t *g = &(groups[gid]);
+      nid = g->first;
+
+      if ((g->resolved == NULL) || (g->flags & NET_F_ROTATE))
+         continue;
+
+      const size_t nbytes = g->length * g->size;
+      resolved -= nbytes;
+      last -= nbytes;
+
+      memcpy(resolved, g->resolved, nbytes);
+      memcpy(last, g->last_value, nbytes);
+
+      if (g->flags & NET_F_OWNS_MEM) {
+         free(g->resolved);
+         g->flags &= ~NET_F_OWNS_MEM;
+      }
+
+      g->resolved   = resolved;
+      g->last_value = last;
+   }
+
+   assert(resolved == arena);
+
+   for (unsigned i = 0; i < n_shadows; i++) {
+      const netgroup_t *g = &(groups[netdb_lookup(netdb, shadows[i].nid)]);
+      *(shadows[i].ptr) = (uint8_t *)g->resolved
+         + ((shadows[i].nid - g->first) * g->size);
+   }
+
+   free(shadows);
+   shadows = NULL;
+   n_shadows = shadows_alloc = 0;
+
+   TRACE("signal value arena is %zu bytes", arena_size * 2);
+}
+
 static void rt_initial(tree_t top)
 {
    // Initialisation is described in LRM 93 section 12.6.4
@@ -1536,15 +3620,26 @@ static void rt_initial(tree_t top)
 
    rt_call_module_reset(tree_ident(top));
 
+   rt_build_arena();
+
    for (size_t i = 0; i < n_procs; i++)
       rt_run(&procs[i], true /* reset */);
 
-   TRACE("calculate initial driver values");
+   rt_build_fanout();
 
    init_side_effect = SIDE_EFFECT_ALLOW;
-   netdb_walk(netdb, rt_group_inital);
+
+   // Every signal value is replaced when restoring a checkpoint
+   if (!restoring) {
+      TRACE("calculate initial driver values");
+      netdb_walk(netdb, rt_group_inital);
+   }
 
    TRACE("used %d bytes of global temporary stack", global_tmp_alloc);
+
+   const char *trace_file = opt_get_str("rt-trace-file");
+   if (trace_file != NULL)
+      rt_trace_open(trace_file, opt_get_int("rt-trace-records"));
 }
 
 static void rt_watch_signal(watch_t *w)
@@ -1553,13 +3648,14 @@ static void rt_watch_signal(watch_t *w)
    int offset = 0;
    while (offset < nnets) {
       netid_t nid = tree_net(w->signal, offset);
-      netgroup_t *g = &(groups[netdb_lookup(netdb, nid)]);
+      groupid_t gid = netdb_lookup(netdb, nid);
+      netgroup_t *g = &(groups[gid]);
 
       watch_list_t *link = xmalloc(sizeof(watch_list_t));
-      link->next  = g->watching;
+      link->next  = infos[gid].watching;
       link->watch = w;
 
-      g->watching = link;
+      infos[gid].watching = link;
 
       offset += g->length;
       (w->n_groups)++;
@@ -1588,11 +3684,17 @@ static void rt_wakeup(sens_list_t *sl)
    // generation: these correspond to stale "wait on" statements that
    // have already resumed.
 
-   if ((sl->wakeup_gen == sl->proc->wakeup_gen) || (sl->reenq != NULL)) {
+   if ((sl->wakeup_gen == sl->proc->wakeup_gen) || sl->is_static) {
       TRACE("wakeup process %s%s", istr(tree_ident(sl->proc->source)),
             sl->proc->postponed ? " [postponed]" : "");
       ++(sl->proc->wakeup_gen);
 
+      if (unlikely(trace_hdr != NULL))
+         rt_trace_rec(TRACE_WAKEUP, sl->proc - procs, 0);
+
+      if (unlikely(profile != NULL) && (profile_cause != NULL))
+         profile[profile_cause - procs].wakeups++;
+
       if (unlikely(sl->proc->postponed)) {
          sl->next  = postponed;
          postponed = sl;
@@ -1606,72 +3708,301 @@ static void rt_wakeup(sens_list_t *sl)
       rt_free(sens_list_stack, sl);
 }
 
-static bool rt_sched_driver(netgroup_t *group, uint64_t after,
-                            uint64_t reject, value_t *values)
+static void rt_cancel_event(event_t *e, netgroup_t *group, int driver)
 {
-   if (unlikely(reject > after))
-      fatal("signal %s pulse reject limit %s is greater than "
-            "delay %s", fmt_group(group), fmt_time(reject), fmt_time(after));
+   // The event cannot be removed from the queue cheaply so mark it dead
+   // and let it be discarded when it reaches the front
+
+   if (e->kind == E_TRANSACTION) {
+      if (e->txn == NULL) {
+         // Still collecting parts for the active process so drop this
+         // part from the batch before it is queued
+         for (unsigned i = 0; i < n_batches; i++) {
+            batch_t *b = &(batches[i]);
+            if (b->event != e)
+               continue;
+
+            for (unsigned j = 0; j < b->nparts; j++) {
+               if (b->parts[j].group == group
+                   && b->parts[j].driver == driver) {
+                  b->parts[j] = b->parts[--(b->nparts)];
+                  return;
+               }
+            }
+         }
 
-   int driver = 0;
-   if (unlikely(group->n_drivers != 1)) {
-      // Try to find this process in the list of existing drivers
-      for (driver = 0; driver < group->n_drivers; driver++) {
-         if (likely(group->drivers[driver].proc == active_proc))
-            break;
+         assert(false);
+      }
+
+      // Other groups in the transaction may still be live so only
+      // drop this part and leave the event in the queue
+      txn_t *txn = e->txn;
+      for (unsigned i = 0; i < txn->nparts; i++) {
+         if (txn->parts[i].group == group
+             && txn->parts[i].driver == driver) {
+            txn->parts[i].group = NULL;
+            if (--(txn->nlive) == 0)
+               n_cancelled++;
+            return;
+         }
       }
 
-      assert(driver != group->n_drivers);
+      assert(false);
    }
 
-   driver_t *d = &(group->drivers[driver]);
+   assert(e->kind == E_DRIVER);
+   e->group = NULL;
+   n_cancelled++;
+}
 
-   const size_t valuesz = group->size * group->length;
+static void rt_grow_driver(driver_t *d, size_t valuesz)
+{
+   const size_t stride = WAVE_STRIDE(valuesz);
 
-   waveform_t *w = rt_alloc(waveform_stack);
-   w->when   = now + after;
-   w->next   = NULL;
-   w->values = values;
-
-   waveform_t *last = d->waveforms;
-   waveform_t *it   = last->next;
-   while ((it != NULL) && (it->when < w->when)) {
-      // If the current transaction is within the pulse rejection interval
-      // and the value is different to that of the new transaction then
-      // delete the current transaction
-      if ((it->when >= w->when - reject)
-          && (memcmp(it->values->data, w->values->data, valuesz) != 0)) {
-         waveform_t *next = it->next;
-         last->next = next;
-         rt_free_value(group, it->values);
-         rt_free(waveform_stack, it);
-         it = next;
-      }
+   uint8_t *ring = rt_pool_alloc(value_pool, d->capacity * 2 * stride);
+   for (unsigned i = 0; i < d->count; i++)
+      memcpy(ring + (i * stride), rt_wave(d, valuesz, i), stride);
+
+   rt_pool_free(value_pool, d->ring, d->capacity * stride);
+
+   d->ring      = ring;
+   d->head      = 0;
+   d->capacity *= 2;
+}
+
+static event_t *rt_batch_driver(uint64_t after, netgroup_t *group,
+                                int driver)
+{
+   // Transactions scheduled by the active process for the same time
+   // are collected into a single event which is queued when the
+   // process suspends
+
+   const uint64_t when = now + after;
+
+   batch_t *b = NULL;
+   for (unsigned i = 0; i < n_batches; i++) {
+      if (batches[i].event->when == when) {
+         b = &(batches[i]);
+         break;
+      }
+   }
+
+   if (b == NULL) {
+      if (unlikely(n_batches == MAX_BATCHES))
+         return deltaq_insert_driver(after, group, active_proc, driver);
+
+      event_t *e = rt_alloc(event_stack);
+      e->when       = when;
+      e->kind       = E_TRANSACTION;
+      e->proc       = active_proc;
+      e->group      = NULL;
+      e->txn        = NULL;
+      e->wakeup_gen = UINT32_MAX;
+
+      b = &(batches[n_batches++]);
+      b->event  = e;
+      b->nparts = 0;
+   }
+
+   if (unlikely(b->nparts == b->alloc)) {
+      b->alloc = MAX(b->alloc * 2, 16);
+      b->parts = xrealloc(b->parts, b->alloc * sizeof(txn_part_t));
+   }
+
+   b->parts[b->nparts].group  = group;
+   b->parts[b->nparts].driver = driver;
+   b->nparts++;
+
+   return b->event;
+}
+
+static void rt_flush_batches(void)
+{
+   for (unsigned i = 0; i < n_batches; i++) {
+      batch_t *b = &(batches[i]);
+      event_t *e = b->event;
+
+      if (b->nparts == 0) {
+         // Every transaction in the batch was preempted
+         rt_free(event_stack, e);
+         n_cancelled++;
+      }
       else {
-         last = it;
-         it = it->next;
+         if (b->nparts == 1) {
+            e->kind   = E_DRIVER;
+            e->group  = b->parts[0].group;
+            e->driver = b->parts[0].driver;
+         }
+         else {
+            const size_t sz =
+               sizeof(txn_t) + b->nparts * sizeof(txn_part_t);
+            txn_t *txn = rt_pool_alloc(value_pool, sz);
+            txn->nparts = b->nparts;
+            txn->nlive  = b->nparts;
+            memcpy(txn->parts, b->parts, b->nparts * sizeof(txn_part_t));
+
+            e->txn = txn;
+         }
+
+         deltaq_insert(e);
+      }
+
+      b->event  = NULL;
+      b->nparts = 0;
+   }
+
+   n_batches = 0;
+}
+
+static void rt_sched_driver(netgroup_t *group, uint64_t after,
+                            uint64_t reject, const void *values, int slot)
+{
+   if (unlikely(reject > after))
+      fatal("signal %s pulse reject limit %s is greater than "
+            "delay %s", fmt_group(group), fmt_time(reject), fmt_time(after));
+
+   if (unlikely(profile != NULL) && (active_proc != NULL))
+      profile[active_proc - procs].txns++;
+
+   if (unlikely(trace_hdr != NULL))
+      rt_trace_rec(TRACE_SCHED, group - groups,
+                   active_proc ? active_proc - procs : UINT32_MAX);
+
+   int driver = 0;
+   if (unlikely(group->n_drivers != 1)) {
+      // The slot assigned during lowering is exact unless several
+      // processes drive disjoint parts of the same signal
+      if (likely((slot >= 0) && (slot < group->n_drivers)
+                 && (group->drivers[slot].proc == active_proc)))
+         driver = slot;
+      else {
+         driver = rt_find_driver(group, active_proc);
+         assert(driver != group->n_drivers);
+      }
+   }
+
+   driver_t *d = &(group->drivers[driver]);
+
+   const size_t valuesz = group->size * group->length;
+   const uint64_t when = now + after;
+
+   event_t *event = NULL;
+
+   if (unlikely(d->count > 1)) {
+      unsigned i, keep = 1;
+      for (i = 1; i < d->count; i++) {
+         waveform_t *it = rt_wave(d, valuesz, i);
+         if (it->when >= when)
+            break;
+
+         // If the current transaction is within the pulse rejection
+         // interval and the value is different to that of the new
+         // transaction then delete the current transaction
+         if ((it->when >= when - reject)
+             && (memcmp(it->data, values, valuesz) != 0))
+            rt_cancel_event(it->event, group, driver);
+         else {
+            if (keep != i)
+               memcpy(rt_wave(d, valuesz, keep), it, WAVE_STRIDE(valuesz));
+            keep++;
+         }
       }
+
+      // Delete all transactions later than this along with their events
+      // unless one is at the same time as the new transaction in which
+      // case its event is reused
+      for (; i < d->count; i++) {
+         waveform_t *it = rt_wave(d, valuesz, i);
+         if (it->when == when)
+            event = it->event;
+         else
+            rt_cancel_event(it->event, group, driver);
+      }
+
+      d->count = keep;
    }
-   w->next = NULL;
-   last->next = w;
 
-   // Delete all transactions later than this
-   // We could remove this transaction from the deltaq as well but the
-   // overhead of doing so is probably higher than the cost of waking
-   // up for the empty event
-   bool already_scheduled = false;
-   while (it != NULL) {
-      rt_free_value(group, it->values);
+   if (unlikely(d->count == d->capacity))
+      rt_grow_driver(d, valuesz);
 
-      if (it->when == w->when)
-         already_scheduled = true;
+   waveform_t *w = rt_wave(d, valuesz, (d->count)++);
+   w->when = when;
+   memcpy(w->data, values, valuesz);
 
-      waveform_t *next = it->next;
-      rt_free(waveform_stack, it);
-      it = next;
+   w->event = event ?: rt_batch_driver(after, group, driver);
+}
+
+static void rt_clock_cb(uint64_t when, void *user)
+{
+   rt_clock_t *c = user;
+
+   TRACE("clock %s phase %u", fmt_group(c->group), c->phase);
+
+   // The "not S" forms complement the effective value which may differ
+   // from the last value driven if the signal was forced or deposited
+   unsigned next = c->phase;
+   if (c->toggle) {
+      const bool is_v1 =
+         memcmp(c->group->resolved, &(c->values[1]), c->group->size) == 0;
+      next = is_v1 ? 0 : 1;
    }
 
-   return already_scheduled;
+   // Pulse rejection is not needed as the process this replaces would
+   // only ever run after its previous transaction matured
+   rt_proc_t *saved = active_proc;
+   active_proc = c->proc;
+   rt_sched_driver(c->group, c->after, 0, &(c->values[next]), c->slot);
+   rt_flush_batches();
+   active_proc = saved;
+
+   rt_set_timeout_cb(c->periods[c->phase], rt_clock_cb, c);
+   c->phase ^= 1;
+}
+
+static void rt_free_clocks(void)
+{
+   while (clocks != NULL) {
+      rt_clock_t *next = clocks->next;
+      free(clocks);
+      clocks = next;
+   }
+}
+
+static inline bool rt_edge_match(const netgroup_t *group, uint16_t edges)
+{
+   const uint8_t pos = *(const uint8_t *)group->resolved;
+   return (pos < 16) && (edges & (1 << pos));
+}
+
+static void rt_wakeup_global_fn(uint32_t low, uint32_t high, void *user,
+                                void *context)
+{
+   sens_list_t *sl = user;
+   rt_unlink_global(sl);
+   rt_wakeup(sl);
+}
+
+static void rt_count_activity(const netgroup_t *group, int32_t flags)
+{
+   rt_activity_t *a = &(activity[group - groups]);
+
+   if (a->txns == 0 || a->step_when != now) {
+      a->steps++;
+      a->step_when   = now;
+      a->step_txns   = 0;
+      a->step_events = 0;
+   }
+
+   a->txns++;
+   a->max_step_txns = MAX(a->max_step_txns, ++(a->step_txns));
+
+   // A second event in the same time step means the value changed and
+   // then changed again in a later delta cycle
+   if (flags & NET_F_EVENT) {
+      a->events++;
+      if (++(a->step_events) == 2)
+         a->glitches++;
+   }
 }
 
 static void rt_update_group(netgroup_t *group, int driver, void *values)
@@ -1684,6 +4015,13 @@ static void rt_update_group(netgroup_t *group, int driver, void *values)
    const int32_t new_flags = rt_resolve_group(group, driver, values);
    group->flags |= new_flags;
 
+   if (unlikely(activity != NULL))
+      rt_count_activity(group, new_flags);
+
+   if (unlikely(trace_hdr != NULL))
+      rt_trace_rec((new_flags & NET_F_EVENT) ? TRACE_EVENT : TRACE_UPDATE,
+                   group - groups, 0);
+
    if (unlikely(n_active_groups == n_active_alloc)) {
       n_active_alloc *= 2;
       const size_t newsz = n_active_alloc * sizeof(struct netgroup *);
@@ -1693,41 +4031,43 @@ static void rt_update_group(netgroup_t *group, int driver, void *values)
 
    // Wake up any processes sensitive to this group
    if (new_flags & NET_F_EVENT) {
-      sens_list_t *it, *last = NULL, *next = NULL;
+      sens_list_t *it, *next = NULL;
+
+      // Static sensitivity is a flat scan of this group's fanout
+      // entries: a process is disarmed when it is woken and armed
+      // again when it returns to its wait so it is scheduled at most
+      // once however many of its signals change. Edge triggered
+      // processes are skipped when the new value cannot satisfy the
+      // edge condition
+      const groupid_t gid = group - groups;
+      for (uint32_t i = fanout_start[gid]; i < fanout_start[gid + 1]; i++) {
+         sens_list_t *sl = fanout[i];
+         if (!sl->proc->armed)
+            continue;
+         else if (unlikely(sl->edges != 0) && !rt_edge_match(group, sl->edges))
+            continue;
+
+         sl->proc->armed = false;
+         rt_wakeup(sl);
+      }
 
-      // First wakeup everything on the group specific pending list
+      // Then wakeup everything on the group specific pending list
       for (it = group->pending; it != NULL; it = next) {
          next = it->next;
          rt_wakeup(it);
          group->pending = next;
       }
 
-      // Now check the global pending list
-      if (group->flags & NET_F_GLOBAL) {
-         for (it = pending; it != NULL; it = next) {
-            next = it->next;
-
-            const netid_t x = group->first;
-            const netid_t y = group->first + group->length - 1;
-            const netid_t a = it->first;
-            const netid_t b = it->last;
-
-            const bool hit = (x <= b) && (a <= y);
-
-            if (hit) {
-               rt_wakeup(it);
-               if (last == NULL)
-                  pending = next;
-               else
-                  last->next = next;
-            }
-            else
-               last = it;
-         }
-      }
+      // Now wakeup everything on the global pending list waiting on
+      // nets that overlap this group
+      if (group->flags & NET_F_GLOBAL)
+         itree_extract(pending, group->first,
+                       group->first + group->length - 1,
+                       rt_wakeup_global_fn, NULL);
 
       // Schedule any callbacks to run
-      for (watch_list_t *wl = group->watching; wl != NULL; wl = wl->next) {
+      watch_list_t *wl = rt_group_info(group)->watching;
+      for (; wl != NULL; wl = wl->next) {
          if (!wl->watch->pending) {
             wl->watch->chain_pending = callbacks;
             wl->watch->pending = true;
@@ -1737,36 +4077,40 @@ static void rt_update_group(netgroup_t *group, int driver, void *values)
    }
 }
 
-static void rt_update_driver(netgroup_t *group, rt_proc_t *proc)
+static void rt_update_driver(netgroup_t *group, rt_proc_t *proc, int driver)
 {
    if (likely(proc != NULL)) {
-      // Find the driver owned by proc
-      int driver;
-      for (driver = 0; driver < group->n_drivers; driver++) {
-         if (likely(group->drivers[driver].proc == proc))
-            break;
-      }
-      assert(driver != group->n_drivers);
+      assert(group->drivers[driver].proc == proc);
 
-      waveform_t *w_now  = group->drivers[driver].waveforms;
-      waveform_t *w_next = w_now->next;
+      driver_t *d = &(group->drivers[driver]);
+      const size_t valuesz = group->size * group->length;
 
-      if (likely((w_next != NULL) && (w_next->when == now))) {
-         rt_update_group(group, driver, w_next->values->data);
-         group->drivers[driver].waveforms = w_next;
-         rt_free_value(group, w_now->values);
-         rt_free(waveform_stack, w_now);
+      waveform_t *w_next = rt_wave(d, valuesz, 1);
+
+      if (likely((d->count > 1) && (w_next->when == now))) {
+         rt_update_group(group, driver, w_next->data);
+
+         w_next->event = NULL;
+         d->head = (d->head + 1) & (d->capacity - 1);
+         d->count--;
       }
-      else
-         assert(w_now != NULL);
    }
    else if (group->flags & NET_F_FORCED)
-      rt_update_group(group, -1, group->forcing->data);
+      rt_update_group(group, -1, rt_group_info(group)->forcing->data);
 }
 
 static bool rt_stale_event(event_t *e)
 {
-   return (e->kind == E_PROCESS) && (e->wakeup_gen != e->proc->wakeup_gen);
+   switch (e->kind) {
+   case E_PROCESS:
+      return e->wakeup_gen != e->proc->wakeup_gen;
+   case E_DRIVER:
+      return e->group == NULL;
+   case E_TRANSACTION:
+      return e->txn->nlive == 0;
+   default:
+      return false;
+   }
 }
 
 static void rt_push_run_queue(event_t *e)
@@ -1783,9 +4127,13 @@ static void rt_push_run_queue(event_t *e)
       }
    }
 
-   if (unlikely(rt_stale_event(e)))
-      rt_free(event_stack, e);
+   if (unlikely(rt_stale_event(e))) {
+      n_stale++;
+      rt_free_event(e);
+   }
    else {
+      n_executed++;
+      n_events[e->kind]++;
       run_queue.queue[(run_queue.wr)++] = e;
       if (e->kind == E_PROCESS)
          ++(e->proc->wakeup_gen);
@@ -1822,25 +4170,128 @@ static void rt_iteration_limit(void)
    fatal("%s", tb_get(buf));
 }
 
+static void rt_update_event(event_t *event)
+{
+   // Processes woken by this update are counted against the driver
+   profile_cause = event->proc;
+
+   if (event->kind == E_DRIVER)
+      rt_update_driver(event->group, event->proc, event->driver);
+   else {
+      const txn_t *txn = event->txn;
+      for (unsigned i = 0; i < txn->nparts; i++) {
+         if (txn->parts[i].group != NULL)
+            rt_update_driver(txn->parts[i].group, event->proc,
+                             txn->parts[i].driver);
+      }
+   }
+
+   profile_cause = NULL;
+}
+
+static bool rt_delta_is_levelised(void)
+{
+   // True if the next delta cycle would only apply transactions from
+   // levelised combinational processes
+
+   if (delta_driver == NULL || delta_proc != NULL)
+      return false;
+
+   for (event_t *e = delta_driver; e != NULL; e = e->delta_chain) {
+      if (e->proc == NULL || e->proc->level == 0)
+         return false;
+   }
+
+   return true;
+}
+
 static void rt_resume_processes(sens_list_t **list)
 {
-   sens_list_t *it = *list;
-   while (it != NULL) {
-      rt_run(it->proc, false /* reset */);
+   for (sens_list_t *it = *list; it != NULL; it = it->next)
+      rt_push_job(it->proc, it);
+
+   *list = NULL;
 
-      sens_list_t *next = it->next;
+   rt_run_jobs();
+}
 
-      if (it->reenq == NULL)
-         rt_free(sens_list_stack, it);
-      else {
-         it->next = *(it->reenq);
-         *(it->reenq) = it;
+static void rt_levelise(void)
+{
+   // Apply zero delay transactions from levelised processes in the
+   // current cycle and run the processes they wake in increasing order
+   // of level. A process can only be woken by one at a lower level so
+   // each is evaluated at most once. Other processes woken along the
+   // way run afterwards as they would in the next delta cycle.
+
+   sens_list_t *deferred = NULL;
+   unsigned lowest = max_level + 1;
+
+   for (;;) {
+      if (delta_driver != NULL) {
+         if (!rt_delta_is_levelised())
+            break;
+
+         event_t *chain = delta_driver, *next;
+         delta_driver = NULL;
+
+         for (event_t *e = chain; e != NULL; e = next) {
+            next = e->delta_chain;
+            if (!rt_stale_event(e)) {
+               n_executed++;
+               n_events[e->kind]++;
+               rt_update_event(e);
+            }
+            else
+               n_stale++;
+            rt_free_event(e);
+         }
+
+         n_collapsed++;
+
+         sens_list_t *it, *snext;
+         for (it = resume; it != NULL; it = snext) {
+            snext = it->next;
+
+            const unsigned level = it->proc->level;
+            if (level > 0) {
+               it->next = level_wake[level];
+               level_wake[level] = it;
+               lowest = MIN(lowest, level);
+            }
+            else {
+               it->next = deferred;
+               deferred = it;
+            }
+         }
+         resume = NULL;
       }
 
-      it = next;
+      while (lowest <= max_level && level_wake[lowest] == NULL)
+         lowest++;
+
+      if (lowest > max_level)
+         break;
+
+      TRACE("evaluate level %u", lowest);
+
+      for (sens_list_t *it = level_wake[lowest]; it != NULL; it = it->next)
+         rt_push_job(it->proc, it);
+      level_wake[lowest] = NULL;
+
+      rt_run_jobs();
    }
 
-   *list = NULL;
+   // Anything left over runs with the processes woken normally
+   for (; lowest <= max_level; lowest++) {
+      while (level_wake[lowest] != NULL) {
+         sens_list_t *next = level_wake[lowest]->next;
+         level_wake[lowest]->next = deferred;
+         deferred = level_wake[lowest];
+         level_wake[lowest] = next;
+      }
+   }
+
+   rt_resume_processes(&deferred);
 }
 
 static void rt_event_callback(bool postponed)
@@ -1875,14 +4326,15 @@ static void rt_cycle(int stop_delta)
    if (is_delta_cycle)
       iteration = iteration + 1;
    else {
-      event_t *peek = heap_min(eventq_heap);
+      event_t *peek = eventq_min();
       while (unlikely(rt_stale_event(peek))) {
          // Discard stale events
-         rt_free(event_stack, heap_extract_min(eventq_heap));
-         if (heap_size(eventq_heap) == 0)
+         n_stale++;
+         rt_free_event(eventq_extract_min());
+         if (eventq_size() == 0)
             return;
          else
-            peek = heap_min(eventq_heap);
+            peek = eventq_min();
       }
       now = peek->when;
       iteration = 0;
@@ -1890,6 +4342,13 @@ static void rt_cycle(int stop_delta)
 
    TRACE("begin cycle");
 
+   n_cycles++;
+
+   if (is_delta_cycle)
+      max_deltas = MAX(max_deltas, iteration);
+   else
+      n_time_steps++;
+
 #if TRACE_DELTAQ > 0
    if (trace_on)
       deltaq_dump();
@@ -1912,221 +4371,1066 @@ static void rt_cycle(int stop_delta)
    else {
       rt_global_event(RT_NEXT_TIME_STEP);
 
-      for (;;) {
-         rt_push_run_queue(heap_extract_min(eventq_heap));
+      for (;;) {
+         rt_push_run_queue(eventq_extract_min());
+
+         if (eventq_size() == 0)
+            break;
+
+         event_t *peek = eventq_min();
+         if (peek->when > now)
+            break;
+      }
+   }
+
+   event_t *event;
+   while ((event = rt_pop_run_queue())) {
+      if (event->kind == E_PROCESS)
+         rt_push_job(event->proc, NULL);
+      else {
+         rt_run_jobs();
+
+         if (event->kind == E_TIMEOUT)
+            (*event->timeout_fn)(now, event->timeout_user);
+         else
+            rt_update_event(event);
+      }
+
+      rt_free_event(event);
+   }
+
+   rt_run_jobs();
+
+   if (unlikely(now == 0 && iteration == 0)) {
+      vcd_restart();
+      lxt_restart();
+      fst_restart();
+   }
+   else if (unlikely((stop_delta > 0) && (iteration == stop_delta)))
+      rt_iteration_limit();
+
+   // Run all non-postponed event callbacks
+   rt_event_callback(false);
+
+   // Run all processes that resumed because of signal events
+   rt_resume_processes(&resume);
+
+   if (levelise && rt_delta_is_levelised()) {
+      rt_levelise();
+      rt_event_callback(false);
+   }
+
+   rt_global_event(RT_END_OF_PROCESSES);
+
+   for (unsigned i = 0; i < n_active_groups; i++) {
+      netgroup_t *g = active_groups[i];
+      g->flags &= ~(NET_F_ACTIVE | NET_F_EVENT);
+   }
+   n_active_groups = 0;
+
+   if (!rt_next_cycle_is_delta()) {
+      can_create_delta = false;
+      rt_global_event(RT_LAST_KNOWN_DELTA_CYCLE);
+
+      // Run any postponed processes
+      rt_resume_processes(&postponed);
+
+      // Execute all postponed event callbacks
+      rt_event_callback(true);
+
+      can_create_delta = true;
+   }
+}
+
+static void rt_load_unit(const char *name)
+{
+   char *tmp = strdup(name);
+   const char *lib_name  = strtok(tmp, ".");
+
+   lib_t lib = lib_find(lib_name, true, true);
+   if (lib == NULL)
+      fatal("cannot continue");
+
+   tree_rd_ctx_t ctx = NULL;
+   if (lib_get_ctx(lib, ident_new(name), &ctx) == NULL)
+      fatal("cannot find unit %s", name);
+
+   struct loaded *l = xmalloc(sizeof(struct loaded));
+   l->next     = NULL;
+   l->name     = name;
+   l->read_ctx = ctx;
+
+   if (loaded == NULL)
+      loaded = l;
+   else {
+      struct loaded *it;
+      for (it = loaded; it->next != NULL; it = it->next)
+         ;
+      it->next = l;
+   }
+
+   free(tmp);
+}
+
+static tree_t rt_recall_tree(const char *unit, int32_t where)
+{
+   rt_serial_begin();
+
+   struct loaded *it;
+   for (it = loaded; (it != NULL) && (it->name != unit); it = it->next)
+      ;
+
+   if (it == NULL) {
+      rt_load_unit(unit);
+      for (it = loaded; it->name != unit; it = it->next)
+         ;
+   }
+
+   tree_t t = tree_read_recall(it->read_ctx, where);
+
+   rt_serial_end();
+   return t;
+}
+
+static void rt_cleanup_group(groupid_t gid, netid_t first, unsigned length)
+{
+   netgroup_t *g = &(groups[gid]);
+   netinfo_t *info = &(infos[gid]);
+
+   assert(g->first == first);
+   assert(g->length == length);
+
+   if (g->flags & NET_F_ROTATE)
+      free(MIN(MIN(g->resolved, g->last_value), info->scratch));
+   else if (g->flags & NET_F_OWNS_MEM)
+      free(g->resolved);
+
+   rt_free_value(g, info->forcing);
+
+   const size_t stride = WAVE_STRIDE(g->size * g->length);
+   for (int j = 0; j < g->n_drivers; j++)
+      rt_pool_free(value_pool, g->drivers[j].ring,
+                   g->drivers[j].capacity * stride);
+   free(g->drivers);
+   free(g->histogram);
+
+   while (g->pending != NULL) {
+      sens_list_t *next = g->pending->next;
+      rt_free(sens_list_stack, g->pending);
+      g->pending = next;
+   }
+
+   while (info->watching != NULL) {
+      watch_list_t *next = info->watching->next;
+      free(info->watching);
+      info->watching = next;
+   }
+}
+
+static void rt_cleanup(tree_t top)
+{
+   assert(resume == NULL);
+
+   // Batches may still be open if a process was aborted
+   rt_flush_batches();
+
+   for (int i = 0; i < MAX_BATCHES; i++) {
+      free(batches[i].parts);
+      batches[i].parts = NULL;
+      batches[i].alloc = 0;
+   }
+
+   while (eventq_size() > 0)
+      rt_free_event(eventq_extract_min());
+
+   rt_free_delta_events(delta_proc);
+   rt_free_delta_events(delta_driver);
+
+   eventq_free();
+
+   rt_free_fanout();
+   netdb_walk(netdb, rt_cleanup_group);
+   netdb_close(netdb);
+
+   free(arena);
+   arena = NULL;
+
+   while (watches != NULL) {
+      watch_t *next = watches->chain_all;
+      rt_free(watch_stack, watches);
+      free(watches->groups);
+      watches = next;
+   }
+
+   rt_free_pending();
+   rt_free_clocks();
+
+   free(level_wake);
+   level_wake = NULL;
+
+   for (int i = 0; i < RT_LAST_EVENT; i++) {
+      while (global_cbs[i] != NULL) {
+         callback_t *tmp = global_cbs[i]->next;
+         rt_free(callback_stack, global_cbs[i]);
+         global_cbs[i] = tmp;
+      }
+   }
+
+   const rt_alloc_stack_t stacks[] = {
+      event_stack, sens_list_stack, watch_stack, callback_stack
+   };
+   for (size_t i = 0; i < ARRAY_LEN(stacks); i++) {
+      stack_stats[i].name    = stacks[i]->name;
+      stack_stats[i].item_sz = stacks[i]->item_sz;
+      stack_stats[i].peak    = stacks[i]->peak;
+      rt_alloc_stack_destroy(stacks[i]);
+   }
+
+   hash_free(res_memo_hash);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Checkpoint and restore
+
+// Checkpoints are written uncompressed in native byte order so that a
+// restore can map the file and copy values straight out of it
+
+typedef struct {
+   FILE          *file;
+   const uint8_t *map;
+   size_t         size;
+   size_t         pos;
+   const char    *name;
+} ckpt_t;
+
+static void ckpt_write_raw(const void *data, size_t len, ckpt_t *f)
+{
+   if (len > 0 && fwrite(data, len, 1, f->file) != 1)
+      fatal_errno("failed to write checkpoint file %s", f->name);
+}
+
+static void ckpt_write_u8(uint8_t value, ckpt_t *f)
+{
+   ckpt_write_raw(&value, sizeof(value), f);
+}
+
+static void ckpt_write_u16(uint16_t value, ckpt_t *f)
+{
+   ckpt_write_raw(&value, sizeof(value), f);
+}
+
+static void ckpt_write_u32(uint32_t value, ckpt_t *f)
+{
+   ckpt_write_raw(&value, sizeof(value), f);
+}
+
+static void ckpt_write_u64(uint64_t value, ckpt_t *f)
+{
+   ckpt_write_raw(&value, sizeof(value), f);
+}
+
+static const void *ckpt_next(size_t len, ckpt_t *f)
+{
+   if (f->pos + len > f->size)
+      fatal("checkpoint %s is truncated", f->name);
+
+   const void *p = f->map + f->pos;
+   f->pos += len;
+   return p;
+}
+
+static void ckpt_read_raw(void *data, size_t len, ckpt_t *f)
+{
+   memcpy(data, ckpt_next(len, f), len);
+}
+
+static uint8_t ckpt_read_u8(ckpt_t *f)
+{
+   return *(const uint8_t *)ckpt_next(sizeof(uint8_t), f);
+}
+
+static uint16_t ckpt_read_u16(ckpt_t *f)
+{
+   uint16_t value;
+   ckpt_read_raw(&value, sizeof(value), f);
+   return value;
+}
+
+static uint32_t ckpt_read_u32(ckpt_t *f)
+{
+   uint32_t value;
+   ckpt_read_raw(&value, sizeof(value), f);
+   return value;
+}
+
+static uint64_t ckpt_read_u64(ckpt_t *f)
+{
+   uint64_t value;
+   ckpt_read_raw(&value, sizeof(value), f);
+   return value;
+}
+
+static const int64_t *rt_checkpoint_table(ident_t unit)
+{
+   char *name LOCAL = xasprintf("%s__checkpoint", istr(unit));
+   const int64_t *table = jit_var_ptr(name, false);
+   if (table == NULL)
+      fatal("%s was not compiled with checkpoint support", istr(unit));
+
+   return table;
+}
+
+static void rt_save_unit(ckpt_t *f, ident_t unit, bool is_process)
+{
+   // Each entry in the table is the address and size of one variable
+   // in the unit's state
+
+   const int64_t *table = rt_checkpoint_table(unit);
+   const int64_t count = table[0];
+
+   if (is_process && (*(void **)(intptr_t)table[3] != NULL))
+      fatal("cannot checkpoint process %s while it is suspended inside "
+            "a procedure", istr(unit));
+
+   ckpt_write_u32(count, f);
+   for (int64_t i = 0; i < count; i++) {
+      const void *ptr = (const void *)(intptr_t)table[1 + (i * 2)];
+      const size_t size = table[2 + (i * 2)];
+      if (size == 0)
+         fatal("cannot checkpoint %s as it has variables of access, file, "
+               "or unconstrained array type", istr(unit));
+
+      ckpt_write_u64(size, f);
+      ckpt_write_raw(ptr, size, f);
+   }
+}
+
+static void rt_restore_unit(ckpt_t *f, ident_t unit, const char *file)
+{
+   const int64_t *table = rt_checkpoint_table(unit);
+   const int64_t count = table[0];
+
+   if (ckpt_read_u32(f) != count)
+      fatal("checkpoint %s does not match the state of %s", file, istr(unit));
+
+   for (int64_t i = 0; i < count; i++) {
+      void *ptr = (void *)(intptr_t)table[1 + (i * 2)];
+      const size_t size = table[2 + (i * 2)];
+      if (ckpt_read_u64(f) != size)
+         fatal("checkpoint %s does not match the state of %s",
+               file, istr(unit));
+
+      ckpt_read_raw(ptr, size, f);
+   }
+}
+
+static unsigned rt_count_clocks(void)
+{
+   unsigned count = 0;
+   for (rt_clock_t *it = clocks; it != NULL; it = it->next)
+      count++;
+   return count;
+}
+
+static unsigned rt_clock_index(const rt_clock_t *c)
+{
+   unsigned index = 0;
+   for (rt_clock_t *it = clocks; it != c; it = it->next, index++)
+      assert(it != NULL);
+   return index;
+}
+
+static rt_clock_t *rt_clock_nth(unsigned index)
+{
+   rt_clock_t *it = clocks;
+   for (; (it != NULL) && (index > 0); it = it->next, index--)
+      ;
+   return it;
+}
+
+static bool rt_checkpoint_due(void)
+{
+   // Checkpoints are only taken between time steps when there are no
+   // delta cycles, resumed processes, or open batches to save
+
+   if ((delta_driver != NULL) || (delta_proc != NULL))
+      return false;
+
+   while ((eventq_size() > 0) && rt_stale_event(eventq_min())) {
+      n_stale++;
+      rt_free_event(eventq_extract_min());
+   }
+
+   return (eventq_size() == 0) || (eventq_min()->when > checkpoint_at);
+}
+
+static void rt_save_checkpoint(tree_t top, const char *file)
+{
+   assert(resume == NULL && postponed == NULL && n_batches == 0);
+
+   ckpt_t ckpt = { .name = file }, *f = &ckpt;
+   if ((f->file = fopen(file, "wb")) == NULL)
+      fatal_errno("failed to create checkpoint file %s", file);
+
+   const size_t ngroups = netdb_size(netdb);
+   const char *top_name = istr(tree_ident(top));
+
+   ckpt_write_u32(CHECKPOINT_MAGIC, f);
+   ckpt_write_u32(strlen(top_name), f);
+   ckpt_write_raw(top_name, strlen(top_name), f);
+   ckpt_write_u32(ngroups, f);
+   ckpt_write_u32(n_procs, f);
+   ckpt_write_u64(now, f);
+
+   rt_save_unit(f, tree_ident(top), false);
+
+   for (size_t i = 0; i < n_procs; i++) {
+      rt_save_unit(f, tree_ident(procs[i].source), true);
+      ckpt_write_u32(procs[i].wakeup_gen, f);
+   }
+
+   ckpt_write_u32(rt_count_clocks(), f);
+   for (rt_clock_t *c = clocks; c != NULL; c = c->next)
+      ckpt_write_u32(c->phase, f);
 
-         if (heap_size(eventq_heap) == 0)
-            break;
+   // Take every event off the queue so each can be numbered and the
+   // waveforms that refer to it written as an index
 
-         event_t *peek = heap_min(eventq_heap);
-         if (peek->when > now)
-            break;
-      }
+   const size_t nevents = eventq_size();
+   event_t **events = xmalloc(MAX(nevents, 1) * sizeof(event_t *));
+   hash_t *index = hash_new(MAX(nevents * 2, 16), true);
+
+   for (size_t i = 0; i < nevents; i++) {
+      events[i] = eventq_extract_min();
+      hash_put(index, events[i], (void *)(uintptr_t)(i + 1));
    }
 
-   event_t *event;
-   while ((event = rt_pop_run_queue())) {
-      switch (event->kind) {
-      case E_PROCESS:
-         rt_run(event->proc, false /* reset */);
-         break;
+   ckpt_write_u32(nevents, f);
+   for (size_t i = 0; i < nevents; i++) {
+      const event_t *e = events[i];
+      ckpt_write_u8(e->kind, f);
+      ckpt_write_u64(e->when, f);
+      ckpt_write_u32(e->wakeup_gen, f);
+      ckpt_write_u32(e->proc ? e->proc - procs : UINT32_MAX, f);
+
+      switch (e->kind) {
       case E_DRIVER:
-         rt_update_driver(event->group, event->proc);
+         ckpt_write_u32(e->group ? e->group - groups : GROUPID_INVALID, f);
+         ckpt_write_u32(e->driver, f);
+         break;
+      case E_TRANSACTION:
+         ckpt_write_u32(e->txn->nparts, f);
+         for (unsigned j = 0; j < e->txn->nparts; j++) {
+            const netgroup_t *g = e->txn->parts[j].group;
+            ckpt_write_u32(g ? g - groups : GROUPID_INVALID, f);
+            ckpt_write_u32(e->txn->parts[j].driver, f);
+         }
          break;
       case E_TIMEOUT:
-         (*event->timeout_fn)(now, event->timeout_user);
+         if (e->timeout_fn != rt_clock_cb)
+            fatal("cannot checkpoint while foreign timeout callbacks "
+                  "are pending");
+         ckpt_write_u32(rt_clock_index(e->timeout_user), f);
+         break;
+      case E_PROCESS:
          break;
       }
-
-      rt_free(event_stack, event);
    }
 
-   if (unlikely(now == 0 && iteration == 0)) {
-      vcd_restart();
-      lxt_restart();
-      fst_restart();
+   for (size_t i = 0; i < nevents; i++)
+      eventq_insert(heap_key(events[i]->when, events[i]->kind), events[i]);
+
+   for (size_t gid = 0; gid < ngroups; gid++) {
+      const netgroup_t *g = &(groups[gid]);
+      const netinfo_t *info = &(infos[gid]);
+      const size_t valuesz = g->size * g->length;
+
+      ckpt_write_u32(g->first, f);
+      ckpt_write_u32(g->length, f);
+      ckpt_write_u16(g->size, f);
+      ckpt_write_u16(g->n_drivers, f);
+      ckpt_write_u32(g->flags & (NET_F_FORCED | NET_F_GLOBAL), f);
+
+      if (g->resolved == NULL)
+         continue;
+
+      ckpt_write_raw(g->resolved, valuesz, f);
+      ckpt_write_raw(g->last_value, valuesz, f);
+      ckpt_write_u64(info->last_event, f);
+
+      if (g->flags & NET_F_FORCED)
+         ckpt_write_raw(info->forcing->data, valuesz, f);
+
+      for (int j = 0; j < g->n_drivers; j++) {
+         const driver_t *d = &(g->drivers[j]);
+         ckpt_write_u32(d->count, f);
+         for (unsigned k = 0; k < d->count; k++) {
+            const waveform_t *w = rt_wave(d, valuesz, k);
+            uintptr_t e = 0;
+            if (w->event != NULL)
+               e = (uintptr_t)hash_get(index, w->event);
+            assert(k == 0 || e != 0);
+            ckpt_write_u64(w->when, f);
+            ckpt_write_u32(e, f);
+            ckpt_write_raw(w->data, valuesz, f);
+         }
+      }
    }
-   else if (unlikely((stop_delta > 0) && (iteration == stop_delta)))
-      rt_iteration_limit();
 
-   // Run all non-postponed event callbacks
-   rt_event_callback(false);
+   hash_free(index);
+   free(events);
 
-   // Run all processes that resumed because of signal events
-   rt_resume_processes(&resume);
-   rt_global_event(RT_END_OF_PROCESSES);
+   // Static sensitivity is registered again when the processes are
+   // reset so only outstanding dynamic waits are saved
 
-   for (unsigned i = 0; i < n_active_groups; i++) {
-      netgroup_t *g = active_groups[i];
-      g->flags &= ~(NET_F_ACTIVE | NET_F_EVENT);
+   for (size_t gid = 0; gid < ngroups; gid++) {
+      for (sens_list_t *it = groups[gid].pending; it != NULL; it = it->next) {
+         if (!it->is_static && (it->wakeup_gen == it->proc->wakeup_gen)) {
+            ckpt_write_u32(gid, f);
+            ckpt_write_u32(it->proc - procs, f);
+         }
+      }
    }
-   n_active_groups = 0;
+   ckpt_write_u32(GROUPID_INVALID, f);
+
+   for (size_t i = 0; i < n_procs; i++) {
+      for (sens_list_t *it = procs[i].global; it != NULL; it = it->next) {
+         if (it->wakeup_gen == procs[i].wakeup_gen) {
+            ckpt_write_u32(i, f);
+            ckpt_write_u32(it->first, f);
+            ckpt_write_u32(it->last, f);
+         }
+      }
+   }
+   ckpt_write_u32(UINT32_MAX, f);
 
-   if (!rt_next_cycle_is_delta()) {
-      can_create_delta = false;
-      rt_global_event(RT_LAST_KNOWN_DELTA_CYCLE);
+   if (fclose(f->file) != 0)
+      fatal_errno("failed to write checkpoint file %s", file);
 
-      // Run any postponed processes
-      rt_resume_processes(&postponed);
+   notef("saved checkpoint at %s to %s", fmt_time(now), file);
+}
 
-      // Execute all postponed event callbacks
-      rt_event_callback(true);
+static void rt_take_checkpoint(void)
+{
+   rt_save_checkpoint(checkpoint_top, checkpoint_file);
 
-      can_create_delta = true;
-   }
+   free(checkpoint_file);
+   checkpoint_file = NULL;
 }
 
-static void rt_load_unit(const char *name)
+static void rt_load_checkpoint(tree_t top, const char *file)
 {
-   char *tmp = strdup(name);
-   const char *lib_name  = strtok(tmp, ".");
+   int fd = open(file, O_RDONLY);
+   if (fd < 0)
+      fatal_errno("failed to open checkpoint file %s", file);
 
-   lib_t lib = lib_find(lib_name, true, true);
-   if (lib == NULL)
-      fatal("cannot continue");
+   struct stat st;
+   if (fstat(fd, &st) != 0)
+      fatal_errno("stat: %s", file);
 
-   tree_rd_ctx_t ctx = NULL;
-   if (lib_get_ctx(lib, ident_new(name), &ctx) == NULL)
-      fatal("cannot find unit %s", name);
+   ckpt_t ckpt = { .name = file, .size = st.st_size }, *f = &ckpt;
 
-   struct loaded *l = xmalloc(sizeof(struct loaded));
-   l->next     = NULL;
-   l->name     = name;
-   l->read_ctx = ctx;
+   void *map = mmap(NULL, MAX(st.st_size, 1), PROT_READ, MAP_PRIVATE, fd, 0);
+   if (map == MAP_FAILED)
+      fatal_errno("mmap");
 
-   if (loaded == NULL)
-      loaded = l;
-   else {
-      struct loaded *it;
-      for (it = loaded; it->next != NULL; it = it->next)
-         ;
-      it->next = l;
-   }
+   close(fd);
 
-   free(tmp);
-}
+   f->map = map;
 
-static tree_t rt_recall_tree(const char *unit, int32_t where)
-{
-   struct loaded *it;
-   for (it = loaded; it != NULL; it = it->next) {
-      if (it->name == unit)
-         return tree_read_recall(it->read_ctx, where);
+   if (ckpt_read_u32(f) != CHECKPOINT_MAGIC)
+      fatal("%s is not a checkpoint file", file);
+
+   const size_t ngroups = netdb_size(netdb);
+   const char *top_name = istr(tree_ident(top));
+
+   const size_t namelen = ckpt_read_u32(f);
+   char *name LOCAL = xmalloc(namelen + 1);
+   ckpt_read_raw(name, namelen, f);
+   name[namelen] = '\0';
+
+   if ((strcmp(name, top_name) != 0) || (ckpt_read_u32(f) != ngroups)
+       || (ckpt_read_u32(f) != n_procs))
+      fatal("checkpoint %s was not saved from %s", file, top_name);
+
+   // Discard everything scheduled by the process resets: the
+   // checkpoint has the complete event queue
+
+   rt_free_delta_events(delta_proc);
+   rt_free_delta_events(delta_driver);
+   delta_proc = delta_driver = NULL;
+
+   while (eventq_size() > 0)
+      rt_free_event(eventq_extract_min());
+
+   now = ckpt_read_u64(f);
+   iteration = 0;
+
+   rt_restore_unit(f, tree_ident(top), file);
+
+   for (size_t i = 0; i < n_procs; i++) {
+      rt_restore_unit(f, tree_ident(procs[i].source), file);
+      procs[i].wakeup_gen = ckpt_read_u32(f);
+      procs[i].armed = true;
    }
 
-   rt_load_unit(unit);
-   return rt_recall_tree(unit, where);
-}
+   const unsigned nclocks = ckpt_read_u32(f);
+   if (nclocks != rt_count_clocks())
+      fatal("checkpoint %s was not saved from %s", file, top_name);
 
-static void rt_cleanup_group(groupid_t gid, netid_t first, unsigned length)
-{
-   netgroup_t *g = &(groups[gid]);
+   for (rt_clock_t *c = clocks; c != NULL; c = c->next)
+      c->phase = ckpt_read_u32(f);
 
-   assert(g->first == first);
-   assert(g->length == length);
+   const size_t nevents = ckpt_read_u32(f);
+   event_t **events = xmalloc(MAX(nevents, 1) * sizeof(event_t *));
 
-   if (g->flags & NET_F_OWNS_MEM)
-      free(g->resolved);
+   for (size_t i = 0; i < nevents; i++) {
+      event_t *e = rt_alloc(event_stack);
+      e->kind         = ckpt_read_u8(f);
+      e->when         = ckpt_read_u64(f);
+      e->wakeup_gen   = ckpt_read_u32(f);
+      e->delta_chain  = NULL;
+      e->group        = NULL;
+      e->txn          = NULL;
+      e->timeout_fn   = NULL;
+      e->timeout_user = NULL;
 
-   free(g->forcing);
+      const uint32_t proc = ckpt_read_u32(f);
+      e->proc = (proc == UINT32_MAX) ? NULL : &(procs[proc]);
 
-   for (int j = 0; j < g->n_drivers; j++) {
-      while (g->drivers[j].waveforms != NULL) {
-         waveform_t *next = g->drivers[j].waveforms->next;
-         rt_free_value(g, g->drivers[j].waveforms->values);
-         rt_free(waveform_stack, g->drivers[j].waveforms);
-         g->drivers[j].waveforms = next;
+      switch (e->kind) {
+      case E_DRIVER:
+         {
+            const groupid_t gid = ckpt_read_u32(f);
+            e->group  = (gid == GROUPID_INVALID) ? NULL : &(groups[gid]);
+            e->driver = ckpt_read_u32(f);
+         }
+         break;
+      case E_TRANSACTION:
+         {
+            const unsigned nparts = ckpt_read_u32(f);
+            const size_t sz = sizeof(txn_t) + nparts * sizeof(txn_part_t);
+            e->txn = rt_pool_alloc(value_pool, sz);
+            e->txn->nparts = nparts;
+            e->txn->nlive  = 0;
+            for (unsigned j = 0; j < nparts; j++) {
+               const groupid_t gid = ckpt_read_u32(f);
+               if (gid == GROUPID_INVALID)
+                  e->txn->parts[j].group = NULL;
+               else {
+                  e->txn->parts[j].group = &(groups[gid]);
+                  e->txn->nlive++;
+               }
+               e->txn->parts[j].driver = ckpt_read_u32(f);
+            }
+         }
+         break;
+      case E_TIMEOUT:
+         e->timeout_fn   = rt_clock_cb;
+         e->timeout_user = rt_clock_nth(ckpt_read_u32(f));
+         break;
+      case E_PROCESS:
+         break;
       }
-   }
-   free(g->drivers);
 
-   while (g->free_values != NULL) {
-      value_t *next = g->free_values->next;
-      free(g->free_values);
-      g->free_values = next;
+      events[i] = e;
+      eventq_insert(heap_key(e->when, e->kind), e);
    }
 
-   while (g->pending != NULL) {
-      sens_list_t *next = g->pending->next;
-      rt_free(sens_list_stack, g->pending);
-      g->pending = next;
-   }
+   for (size_t gid = 0; gid < ngroups; gid++) {
+      netgroup_t *g = &(groups[gid]);
+      netinfo_t *info = &(infos[gid]);
+      const size_t valuesz = g->size * g->length;
 
-   while (g->watching != NULL) {
-      watch_list_t *next = g->watching->next;
-      free(g->watching);
-      g->watching = next;
-   }
-}
+      if ((ckpt_read_u32(f) != g->first) || (ckpt_read_u32(f) != g->length)
+          || (ckpt_read_u16(f) != g->size) || (ckpt_read_u16(f) != g->n_drivers))
+         fatal("checkpoint %s was not saved from %s", file, top_name);
 
-static void rt_cleanup(tree_t top)
-{
-   assert(resume == NULL);
+      g->flags &= ~NET_F_FORCED;
+      g->flags |= ckpt_read_u32(f);
 
-   while (heap_size(eventq_heap) > 0)
-      rt_free(event_stack, heap_extract_min(eventq_heap));
+      if (g->resolved == NULL)
+         continue;
 
-   rt_free_delta_events(delta_proc);
-   rt_free_delta_events(delta_driver);
+      ckpt_read_raw(g->resolved, valuesz, f);
+      ckpt_read_raw(g->last_value, valuesz, f);
+      info->last_event = ckpt_read_u64(f);
 
-   heap_free(eventq_heap);
-   eventq_heap = NULL;
+      if (g->flags & NET_F_FORCED) {
+         if (info->forcing == NULL)
+            info->forcing = rt_alloc_value(g);
+         ckpt_read_raw(info->forcing->data, valuesz, f);
+      }
 
-   netdb_walk(netdb, rt_cleanup_group);
-   netdb_close(netdb);
+      for (int j = 0; j < g->n_drivers; j++) {
+         driver_t *d = &(g->drivers[j]);
+         const unsigned count = ckpt_read_u32(f);
 
-   while (watches != NULL) {
-      watch_t *next = watches->chain_all;
-      rt_free(watch_stack, watches);
-      free(watches->groups);
-      watches = next;
-   }
+         d->count = 0;
+         d->head  = 0;
+         while (d->capacity < count)
+            rt_grow_driver(d, valuesz);
+         d->count = count;
 
-   while (pending != NULL) {
-      sens_list_t *next = pending->next;
-      rt_free(sens_list_stack, pending);
-      pending = next;
-   }
+         for (unsigned k = 0; k < count; k++) {
+            waveform_t *w = rt_wave(d, valuesz, k);
+            w->when = ckpt_read_u64(f);
 
-   for (int i = 0; i < RT_LAST_EVENT; i++) {
-      while (global_cbs[i] != NULL) {
-         callback_t *tmp = global_cbs[i]->next;
-         rt_free(callback_stack, global_cbs[i]);
-         global_cbs[i] = tmp;
+            const uint32_t e = ckpt_read_u32(f);
+            w->event = (e == 0) ? NULL : events[e - 1];
+
+            ckpt_read_raw(w->data, valuesz, f);
+         }
       }
+
+      // Driver counts must match the restored driving values
+      if (g->histogram != NULL)
+         rt_histogram_update(g, -1, NULL, NULL);
    }
 
-   rt_alloc_stack_destroy(event_stack);
-   rt_alloc_stack_destroy(waveform_stack);
-   rt_alloc_stack_destroy(sens_list_stack);
-   rt_alloc_stack_destroy(watch_stack);
-   rt_alloc_stack_destroy(callback_stack);
+   free(events);
 
-   hash_free(res_memo_hash);
+   groupid_t gid;
+   while ((gid = ckpt_read_u32(f)) != GROUPID_INVALID)
+      rt_sched_event(&(groups[gid].pending), &(procs[ckpt_read_u32(f)]),
+                     false, 0);
+
+   uint32_t proc;
+   while ((proc = ckpt_read_u32(f)) != UINT32_MAX) {
+      const netid_t first = ckpt_read_u32(f);
+      const netid_t last = ckpt_read_u32(f);
+      rt_sched_global(first, last, &(procs[proc]), false);
+   }
+
+   munmap(map, MAX(st.st_size, 1));
+
+   TRACE("restored checkpoint at %s from %s", fmt_time(now), file);
 }
 
 static bool rt_stop_now(uint64_t stop_time)
 {
    if ((delta_driver != NULL) || (delta_proc != NULL))
       return false;
-   else if (heap_size(eventq_heap) == 0)
+   else if (eventq_size() == 0)
       return true;
    else if (force_stop)
       return true;
    else if (stop_time == UINT64_MAX)
       return false;
    else {
-      event_t *peek = heap_min(eventq_heap);
+      event_t *peek = eventq_min();
       return peek->when > stop_time;
    }
 }
 
+static void rt_json_string(FILE *f, const char *str)
+{
+   fputc('"', f);
+   for (const char *p = str; *p != '\0'; p++) {
+      if (*p == '"' || *p == '\\')
+         fprintf(f, "\\%c", *p);
+      else if ((unsigned char)*p < 0x20)
+         fprintf(f, "\\u%04x", *p);
+      else
+         fputc(*p, f);
+   }
+   fputc('"', f);
+}
+
+static const char *res_path_names[] = {
+   "none", "table1", "table2", "incremental", "call"
+};
+
+static const char *event_kind_names[] = {
+   "timeout", "driver", "transaction", "process"
+};
+
+static void rt_stats_json(const nvc_rusage_t *ru)
+{
+   // Machine readable equivalent of rt_stats_print for tracking
+   // performance across versions: field names must stay stable
+
+   printf("{\n  \"version\": ");
+   rt_json_string(stdout, PACKAGE_VERSION);
+   printf(",\n  \"setup_ms\": %u,\n  \"run_ms\": %u,\n"
+          "  \"maxrss_kb\": %u,\n", ready_rusage.ms, ru->ms, ru->rss);
+
+   printf("  \"cycles\": %"PRIu64",\n  \"time_steps\": %"PRIu64",\n"
+          "  \"delta_cycles\": %"PRIu64",\n  \"max_deltas\": %d,\n"
+          "  \"collapsed_deltas\": %"PRIu64",\n",
+          n_cycles, n_time_steps, n_cycles - n_time_steps, max_deltas,
+          n_collapsed);
+
+   printf("  \"events\": { \"executed\": %"PRIu64", \"cancelled\": "
+          "%"PRIu64", \"stale\": %"PRIu64, n_executed, n_cancelled,
+          n_stale);
+   for (int i = 0; i < ARRAY_LEN(event_kind_names); i++)
+      printf(", \"%s\": %"PRIu64, event_kind_names[i], n_events[i]);
+   printf(" },\n  \"event_queue_peak\": %zu,\n", eventq_peak);
+
+   printf("  \"stacks\": {");
+   for (int i = 0; i < ARRAY_LEN(stack_stats); i++)
+      printf("%s \"%s\": { \"item_size\": %zu, \"peak\": %zu }",
+             i > 0 ? "," : "", stack_stats[i].name, stack_stats[i].item_sz,
+             stack_stats[i].peak);
+   printf(" },\n");
+
+   printf("  \"resolution\": {");
+   for (int i = 0; i < RES_LAST_PATH; i++)
+      printf("%s \"%s\": { \"calls\": %"PRIu64", \"ns\": %"PRIu64" }",
+             i > 0 ? "," : "", res_path_names[i], res_stats[i].calls,
+             res_stats[i].ns);
+   printf(" },\n");
+
+   printf("  \"vec_load\": { \"copy\": %"PRIu64", \"zero_copy\": "
+          "%"PRIu64" },\n", n_vec_copy, n_vec_zero_copy);
+
+   printf("  \"value_pool\": [");
+   unsigned nclasses;
+   const rt_pool_stats_t *ps = rt_pool_stats(value_pool, &nclasses);
+   for (unsigned i = 0; i < nclasses; i++)
+      printf("%s\n    { \"size\": %zu, \"allocs\": %"PRIu64
+             ", \"peak\": %zu }", i > 0 ? "," : "",
+             (i == nclasses - 1) ? 0 : ps[i].size, ps[i].allocs, ps[i].peak);
+   printf("\n  ]\n}\n");
+}
+
 static void rt_stats_print(void)
 {
    nvc_rusage_t ru;
    nvc_rusage(&ru);
 
+   if (opt_get_int("rt-stats") == RT_STATS_JSON) {
+      rt_stats_json(&ru);
+      return;
+   }
+
    notef("setup:%ums run:%ums maxrss:%ukB", ready_rusage.ms, ru.ms, ru.rss);
+   notef("events executed:%"PRIu64" cancelled:%"PRIu64" cycles:%"PRIu64
+         " per cycle:%.1f", n_executed, n_cancelled, n_cycles,
+         (n_cycles > 0) ? (double)n_executed / n_cycles : 0.0);
+   notef("time steps:%"PRIu64" delta cycles:%"PRIu64" max deltas:%d "
+         "stale events:%"PRIu64" event queue peak:%zu", n_time_steps,
+         n_cycles - n_time_steps, max_deltas, n_stale, eventq_peak);
+   notef("events timeout:%"PRIu64" driver:%"PRIu64" transaction:%"PRIu64
+         " process:%"PRIu64, n_events[E_TIMEOUT], n_events[E_DRIVER],
+         n_events[E_TRANSACTION], n_events[E_PROCESS]);
+
+   if (levelise)
+      notef("collapsed delta cycles:%"PRIu64" max level:%u",
+            n_collapsed, max_level);
+
+   uint64_t total_calls = 0, total_ns = 0;
+   for (int i = 0; i < RES_LAST_PATH; i++) {
+      total_calls += res_stats[i].calls;
+      total_ns    += res_stats[i].ns;
+   }
+
+   notef("resolution calls:%"PRIu64" time:%"PRIu64"ms kernels:%s",
+         total_calls, total_ns / 1000000, resolve_kernel_name());
+
+   for (int i = 0; i < RES_LAST_PATH; i++) {
+      if (res_stats[i].calls > 0)
+         notef("  %-11s calls:%"PRIu64" time:%"PRIu64"ms",
+               res_path_names[i], res_stats[i].calls,
+               res_stats[i].ns / 1000000);
+   }
+
+   unsigned nclasses;
+   const rt_pool_stats_t *ps = rt_pool_stats(value_pool, &nclasses);
+   for (unsigned i = 0; i < nclasses; i++) {
+      if (ps[i].allocs == 0)
+         continue;
+      else if (i == nclasses - 1)
+         notef("value pool >%zuB allocs:%"PRIu64" peak:%zu",
+               ps[i - 1].size, ps[i].allocs, ps[i].peak);
+      else
+         notef("value pool %zuB allocs:%"PRIu64" peak:%zu",
+               ps[i].size, ps[i].allocs, ps[i].peak);
+   }
+
+   for (int i = 0; i < ARRAY_LEN(stack_stats); i++)
+      notef("%s stack item size:%zuB peak:%zu", stack_stats[i].name,
+            stack_stats[i].item_sz, stack_stats[i].peak);
+
+   notef("vector loads copy:%"PRIu64" zero copy:%"PRIu64,
+         n_vec_copy, n_vec_zero_copy);
+}
+
+static int rt_profile_cmp(const void *a, const void *b)
+{
+   const uint64_t na = profile[*(const unsigned *)a].ns;
+   const uint64_t nb = profile[*(const unsigned *)b].ns;
+   return (na < nb) - (na > nb);
+}
+
+static void rt_profile_print(void)
+{
+   // Processes are ranked by the total time spent running them: the
+   // text report shows the most expensive and the JSON has them all
+
+   const int max_rows = 20;
+
+   unsigned *order = xmalloc(n_procs * sizeof(unsigned));
+   uint64_t total_ns = 0;
+   for (unsigned i = 0; i < n_procs; i++) {
+      order[i] = i;
+      total_ns += profile[i].ns;
+   }
+
+   qsort(order, n_procs, sizeof(unsigned), rt_profile_cmp);
+
+   notef("process profile: %zu processes, %"PRIu64"ms total",
+         n_procs, total_ns / 1000000);
+
+   printf("%6s %10s %12s %10s %10s %10s  %s\n", "%time", "ms",
+          "activations", "avg ns", "txns", "wakeups", "process");
+
+   for (unsigned i = 0; i < n_procs && i < max_rows; i++) {
+      const rt_profile_t *p = &(profile[order[i]]);
+      if (p->activations == 0)
+         break;
+
+      const loc_t *loc = tree_loc(procs[order[i]].source);
+      printf("%5.1f%% %10.2f %12"PRIu64" %10"PRIu64" %10"PRIu64
+             " %10"PRIu64"  %s (%s:%d)\n",
+             total_ns ? (100.0 * p->ns) / total_ns : 0.0,
+             p->ns / 1000000.0, p->activations, p->ns / p->activations,
+             p->txns, p->wakeups,
+             istr(tree_ident(procs[order[i]].source)),
+             loc->file ?: "?", loc->first_line);
+   }
+
+   const char *fname = opt_get_str("rt-profile-file");
+   if (fname != NULL) {
+      FILE *f = fopen(fname, "w");
+      if (f == NULL)
+         fatal_errno("failed to create %s", fname);
+
+      fprintf(f, "{\n  \"total_ns\": %"PRIu64",\n  \"processes\": [",
+              total_ns);
+
+      for (unsigned i = 0; i < n_procs; i++) {
+         const rt_profile_t *p = &(profile[order[i]]);
+         const loc_t *loc = tree_loc(procs[order[i]].source);
+
+         fprintf(f, "%s\n    { \"name\": ", i > 0 ? "," : "");
+         rt_json_string(f, istr(tree_ident(procs[order[i]].source)));
+         fprintf(f, ", \"file\": ");
+         rt_json_string(f, loc->file ?: "");
+         fprintf(f, ", \"line\": %d, \"activations\": %"PRIu64
+                 ", \"ns\": %"PRIu64", \"txns\": %"PRIu64
+                 ", \"wakeups\": %"PRIu64" }",
+                 loc->first_line, p->activations, p->ns, p->txns,
+                 p->wakeups);
+      }
+
+      fprintf(f, "\n  ]\n}\n");
+      fclose(f);
+   }
+
+   free(order);
+}
+
+typedef struct {
+   tree_t   decl;
+   uint64_t txns;
+   uint64_t events;
+   uint64_t steps;
+   uint32_t max_step_txns;
+   uint32_t glitches;
+} rt_sig_activity_t;
+
+static int rt_activity_cmp(const void *a, const void *b)
+{
+   const uint64_t na = ((const rt_sig_activity_t *)a)->txns;
+   const uint64_t nb = ((const rt_sig_activity_t *)b)->txns;
+   return (na < nb) - (na > nb);
+}
+
+static void rt_activity_print(void)
+{
+   // Counts for each group are summed over the signal declaration that
+   // owns it so the report is ranked by whole signals: a signal is
+   // flagged as glitchy if any of its groups had more than one event
+   // in a single time step
+
+   const int max_rows = 20;
+
+   const size_t ngroups = netdb_size(netdb);
+   hash_t *map = hash_new(1024, true);
+   rt_sig_activity_t *sigs = xcalloc(ngroups * sizeof(rt_sig_activity_t));
+   size_t nsigs = 0;
+   uint64_t total_txns = 0;
+
+   for (size_t gid = 0; gid < ngroups; gid++) {
+      const rt_activity_t *a = &(activity[gid]);
+      tree_t decl = infos[gid].sig_decl;
+      if (a->txns == 0 || decl == NULL)
+         continue;
+
+      rt_sig_activity_t *sa = hash_get(map, decl);
+      if (sa == NULL) {
+         sa = &(sigs[nsigs++]);
+         sa->decl = decl;
+         hash_put(map, decl, sa);
+      }
+
+      sa->txns         += a->txns;
+      sa->events       += a->events;
+      sa->steps         = MAX(sa->steps, a->steps);
+      sa->max_step_txns = MAX(sa->max_step_txns, a->max_step_txns);
+      sa->glitches     += a->glitches;
+
+      total_txns += a->txns;
+   }
+
+   hash_free(map);
+
+   qsort(sigs, nsigs, sizeof(rt_sig_activity_t), rt_activity_cmp);
+
+   unsigned nglitchy = 0;
+   for (size_t i = 0; i < nsigs; i++) {
+      if (sigs[i].glitches > 0)
+         nglitchy++;
+   }
+
+   notef("signal activity: %zu active signals, %"PRIu64" transactions, "
+         "%u glitchy", nsigs, total_txns, nglitchy);
+
+   printf("%6s %12s %12s %10s %9s %9s %8s  %s\n", "%txns", "txns",
+          "events", "steps", "txns/step", "max/step", "glitches", "signal");
+
+   for (size_t i = 0; i < nsigs && i < max_rows; i++) {
+      const rt_sig_activity_t *sa = &(sigs[i]);
+      const loc_t *loc = tree_loc(sa->decl);
+      printf("%5.1f%% %12"PRIu64" %12"PRIu64" %10"PRIu64" %9.1f %9u %8u"
+             "  %s (%s:%d)%s\n",
+             (100.0 * sa->txns) / total_txns, sa->txns, sa->events,
+             sa->steps, (double)sa->txns / sa->steps, sa->max_step_txns,
+             sa->glitches, istr(tree_ident(sa->decl)), loc->file ?: "?",
+             loc->first_line, sa->glitches > 0 ? " *" : "");
+   }
+
+   const char *fname = opt_get_str("rt-activity-file");
+   FILE *f = fopen(fname, "w");
+   if (f == NULL)
+      fatal_errno("failed to create %s", fname);
+
+   fprintf(f, "signal,file,line,transactions,events,time_steps,"
+           "max_transactions_per_step,glitch_steps\n");
+
+   for (size_t i = 0; i < nsigs; i++) {
+      const rt_sig_activity_t *sa = &(sigs[i]);
+      const loc_t *loc = tree_loc(sa->decl);
+      fprintf(f, "%s,%s,%d,%"PRIu64",%"PRIu64",%"PRIu64",%u,%u\n",
+              istr(tree_ident(sa->decl)), loc->file ?: "",
+              loc->first_line, sa->txns, sa->events, sa->steps,
+              sa->max_step_txns, sa->glitches);
+   }
+
+   fclose(f);
+   free(sigs);
 }
 
 static void rt_emit_coverage(tree_t e)
@@ -2156,9 +5460,11 @@ void rt_start_of_tool(tree_t top, tree_rd_ctx_t ctx)
    sigaction(SIGINT, &sa, NULL);
 
    jit_bind_fn("_std_standard_now", _std_standard_now);
+   jit_bind_fn("_restoring", _restoring);
    jit_bind_fn("_sched_process", _sched_process);
    jit_bind_fn("_sched_waveform", _sched_waveform);
    jit_bind_fn("_sched_event", _sched_event);
+   jit_bind_fn("_sched_clock", _sched_clock);
    jit_bind_fn("_assert_fail", _assert_fail);
    jit_bind_fn("_vec_load", _vec_load);
    jit_bind_fn("_image", _image);
@@ -2176,14 +5482,18 @@ void rt_start_of_tool(tree_t top, tree_rd_ctx_t ctx)
    jit_bind_fn("_last_event", _last_event);
    jit_bind_fn("_div_zero", _div_zero);
    jit_bind_fn("_null_deref", _null_deref);
+   jit_bind_fn("_tmp_stack_ptr", _tmp_stack_ptr);
+
+   trace_on    = opt_get_int("rt_trace_en");
+   profile_res = opt_get_int("rt-stats");
 
-   trace_on = opt_get_int("rt_trace_en");
+   resolve_init();
 
    event_stack     = rt_alloc_stack_new(sizeof(event_t), "event");
-   waveform_stack  = rt_alloc_stack_new(sizeof(waveform_t), "waveform");
    sens_list_stack = rt_alloc_stack_new(sizeof(sens_list_t), "sens_list");
    watch_stack     = rt_alloc_stack_new(sizeof(watch_t), "watch");
    callback_stack  = rt_alloc_stack_new(sizeof(callback_t), "callback");
+   value_pool      = rt_pool_new("value");
 
    n_active_alloc = 128;
    active_groups = xmalloc(n_active_alloc * sizeof(struct netgroup *));
@@ -2193,11 +5503,29 @@ void rt_start_of_tool(tree_t top, tree_rd_ctx_t ctx)
 
    global_tmp_alloc = 0;
 
+   rt_start_threads();
+
+   if (opt_get_str("rt-sample-file") != NULL)
+      rt_start_sampling();
+
    nvc_rusage(&ready_rusage);
 }
 
 void rt_end_of_tool(tree_t top)
 {
+   if (samples != NULL)
+      rt_stop_sampling();
+
+   rt_stop_threads();
+   rt_trace_close();
+
+   if (activity != NULL) {
+      // Must run before the net database is closed
+      rt_activity_print();
+      free(activity);
+      activity = NULL;
+   }
+
    rt_cleanup(top);
    rt_emit_coverage(top);
 
@@ -2205,6 +5533,27 @@ void rt_end_of_tool(tree_t top)
 
    if (opt_get_int("rt-stats"))
       rt_stats_print();
+
+   if (profile != NULL) {
+      rt_profile_print();
+      free(profile);
+      profile = NULL;
+   }
+
+   if (samples != NULL) {
+      rt_sample_print();
+      free(samples);
+      samples = NULL;
+   }
+
+   free(jit_syms);
+   jit_syms = NULL;
+
+   free(jit_lines);
+   jit_lines = NULL;
+
+   rt_pool_destroy(value_pool);
+   value_pool = NULL;
 }
 
 void rt_run_sim(uint64_t stop_time)
@@ -2212,9 +5561,21 @@ void rt_run_sim(uint64_t stop_time)
    const int stop_delta = opt_get_int("stop-delta");
 
    rt_global_event(RT_START_OF_SIMULATION);
-   while (!rt_stop_now(stop_time))
+   while (!rt_stop_now(stop_time)) {
+      if (unlikely(checkpoint_file != NULL) && rt_checkpoint_due())
+         rt_take_checkpoint();
+
       rt_cycle(stop_delta);
+   }
    rt_global_event(RT_END_OF_SIMULATION);
+
+   if (checkpoint_file != NULL) {
+      if (rt_checkpoint_due())
+         rt_take_checkpoint();
+      else
+         warnf("simulation stopped before checkpoint time %s",
+               fmt_time(checkpoint_at));
+   }
 }
 
 static void rt_interactive_fatal(void)
@@ -2227,7 +5588,7 @@ void rt_run_interactive(uint64_t stop_time)
 {
    if (aborted)
       errorf("simulation has aborted and must be restarted");
-   else if ((heap_size(eventq_heap) == 0) && (delta_proc == NULL))
+   else if ((eventq_size() == 0) && (delta_proc == NULL))
       warnf("no future simulation events");
    else {
       set_fatal_fn(rt_interactive_fatal);
@@ -2246,6 +5607,36 @@ void rt_restart(tree_t top)
    aborted = false;
 }
 
+void rt_restore(tree_t top, const char *file)
+{
+   // The process and module resets are run again as they bind signals,
+   // drivers, and sensitivity to the kernel but process variables are
+   // not initialised and initial driving values are not resolved as
+   // the checkpoint replaces all mutable state
+
+   rt_setup(top);
+
+   restoring = true;
+   rt_initial(top);
+   restoring = false;
+
+   rt_load_checkpoint(top, file);
+   aborted = false;
+
+   vcd_restart();
+   lxt_restart();
+   fst_restart();
+}
+
+void rt_set_checkpoint(tree_t top, uint64_t when, const char *file)
+{
+   free(checkpoint_file);
+
+   checkpoint_top  = top;
+   checkpoint_at   = when;
+   checkpoint_file = strdup(file);
+}
+
 void rt_set_timeout_cb(uint64_t when, timeout_fn_t fn, void *user)
 {
    event_t *e = rt_alloc(event_stack);
@@ -2422,15 +5813,16 @@ bool rt_force_signal(tree_t s, const uint64_t *buf, size_t count,
    int offset = 0;
    while (offset < nnets) {
       netid_t nid = tree_net(s, offset);
-      netgroup_t *g = &(groups[netdb_lookup(netdb, nid)]);
+      groupid_t gid = netdb_lookup(netdb, nid);
+      netgroup_t *g = &(groups[gid]);
 
       g->flags |= NET_F_FORCED;
 
-      if (g->forcing == NULL)
-         g->forcing = rt_alloc_value(g);
+      if (infos[gid].forcing == NULL)
+         infos[gid].forcing = rt_alloc_value(g);
 
 #define SIGNAL_FORCE_EXPAND_U64(type) do {                              \
-         type *dp = (type *)g->forcing->data;                           \
+         type *dp = (type *)infos[gid].forcing->data;                   \
          for (int i = 0; (i < g->length) && (offset + i < count); i++)  \
             dp[i] = buf[offset + i];                                    \
       } while (0)
@@ -2438,7 +5830,7 @@ bool rt_force_signal(tree_t s, const uint64_t *buf, size_t count,
       FOR_ALL_SIZES(g->size, SIGNAL_FORCE_EXPAND_U64);
 
       if (propagate)
-         deltaq_insert_driver(0, g, NULL);
+         deltaq_insert_driver(0, g, NULL, -1);
 
       offset += g->length;
    }
@@ -2463,6 +5855,59 @@ void rt_stop(void)
    force_stop = true;
 }
 
+void rt_get_stats(rt_stats_t *stats)
+{
+   memset(stats, '\0', sizeof(rt_stats_t));
+
+   stats->now           = now;
+   stats->events        = n_executed;
+   stats->cancelled     = n_cancelled;
+   stats->stale         = n_stale;
+   stats->cycles        = n_cycles;
+   stats->time_steps    = n_time_steps;
+   stats->collapsed     = n_collapsed;
+   stats->timeouts      = n_events[E_TIMEOUT];
+   stats->drivers       = n_events[E_DRIVER];
+   stats->transactions  = n_events[E_TRANSACTION];
+   stats->wakeups       = n_events[E_PROCESS];
+   stats->vec_copy      = n_vec_copy;
+   stats->vec_zero_copy = n_vec_zero_copy;
+   stats->eventq_peak   = eventq_peak;
+   stats->max_deltas    = max_deltas;
+
+   for (int i = 0; i < RES_LAST_PATH; i++) {
+      stats->res_calls += res_stats[i].calls;
+      stats->res_ns    += res_stats[i].ns;
+   }
+}
+
+pid_t rt_fork(void)
+{
+   // Worker threads do not survive fork so stop them first and start
+   // a new pool in the child
+
+   rt_stop_threads();
+
+   fflush(stdout);
+   fflush(stderr);
+
+   const pid_t pid = fork();
+   if (pid < 0)
+      fatal_errno("fork");
+   else if (pid == 0) {
+      rt_start_threads();
+
+      // Interval timers are not inherited so the child must start its
+      // own and should only report samples taken after the fork
+      if (samples != NULL) {
+         n_samples = 0;
+         rt_arm_sampling();
+      }
+   }
+
+   return pid;
+}
+
 void rt_set_exit_severity(rt_severity_t severity)
 {
    exit_severity = severity;
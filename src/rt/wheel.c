@@ -0,0 +1,237 @@
+//
+//  Copyright (C) 2015  Nick Gasson
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "util.h"
+#include "wheel.h"
+#include "alloc.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Hierarchical timing wheel with the same interface as the binary heap.
+// Each level holds keys that first differ from the current base key in
+// a particular byte so insertion is O(1) and each entry is cascaded to
+// a lower level at most once per level. Keys must never be inserted
+// below the last key extracted. Only extraction moves the base key so
+// a smaller key may still be inserted after peeking at the minimum.
+
+#define WHEEL_BITS   8
+#define WHEEL_SLOTS  (1 << WHEEL_BITS)
+#define WHEEL_MASK   (WHEEL_SLOTS - 1)
+#define WHEEL_LEVELS (64 / WHEEL_BITS)
+#define WHEEL_WORDS  (WHEEL_SLOTS / 64)
+
+typedef struct wnode wnode_t;
+
+struct wnode {
+   uint64_t  key;
+   void     *user;
+   wnode_t  *next;
+};
+
+struct slot {
+   wnode_t *head;
+   wnode_t *tail;
+};
+
+struct wheel {
+   struct slot      slots[WHEEL_LEVELS][WHEEL_SLOTS];
+   uint64_t         bitmap[WHEEL_LEVELS][WHEEL_WORDS];
+   uint64_t         base;
+   size_t           size;
+   rt_alloc_stack_t node_stack;
+};
+
+static void wheel_link(wheel_t w, wnode_t *n)
+{
+   const uint64_t diff = n->key ^ w->base;
+   const int level =
+      (diff == 0) ? 0 : (63 - __builtin_clzll(diff)) / WHEEL_BITS;
+   const int index = (n->key >> (level * WHEEL_BITS)) & WHEEL_MASK;
+
+   struct slot *s = &(w->slots[level][index]);
+
+   n->next = NULL;
+   if (s->tail == NULL) {
+      s->head = n;
+      w->bitmap[level][index / 64] |= (UINT64_C(1) << (index % 64));
+   }
+   else
+      s->tail->next = n;
+   s->tail = n;
+}
+
+static void wheel_unlink_all(wheel_t w, int level, int index)
+{
+   struct slot *s = &(w->slots[level][index]);
+   s->head = s->tail = NULL;
+   w->bitmap[level][index / 64] &= ~(UINT64_C(1) << (index % 64));
+}
+
+static int wheel_next_slot(wheel_t w, int level, int from)
+{
+   for (int word = from / 64; word < WHEEL_WORDS; word++) {
+      uint64_t bits = w->bitmap[level][word];
+      if (word == from / 64)
+         bits &= ~UINT64_C(0) << (from % 64);
+
+      if (bits != 0)
+         return (word * 64) + __builtin_ctzll(bits);
+   }
+
+   return -1;
+}
+
+static struct slot *wheel_first(wheel_t w)
+{
+   // Find the level zero slot holding the smallest key, cascading
+   // entries from higher levels down as the base key advances
+
+   for (;;) {
+      int index = wheel_next_slot(w, 0, w->base & WHEEL_MASK);
+      if (index >= 0)
+         return &(w->slots[0][index]);
+
+      int level;
+      for (level = 1; level < WHEEL_LEVELS; level++) {
+         const int from = ((w->base >> (level * WHEEL_BITS)) & WHEEL_MASK) + 1;
+         if ((index = wheel_next_slot(w, level, from)) >= 0)
+            break;
+      }
+
+      if (level == WHEEL_LEVELS)
+         return NULL;
+
+      const int shift = level * WHEEL_BITS;
+      const uint64_t keep =
+         (shift + WHEEL_BITS >= 64) ? 0 : (~UINT64_C(0) << (shift + WHEEL_BITS));
+
+      w->base = (w->base & keep) | ((uint64_t)index << shift);
+
+      wnode_t *n = w->slots[level][index].head;
+      wheel_unlink_all(w, level, index);
+
+      while (n != NULL) {
+         wnode_t *next = n->next;
+         wheel_link(w, n);
+         n = next;
+      }
+   }
+}
+
+wheel_t wheel_new(void)
+{
+   struct wheel *w = xmalloc(sizeof(struct wheel));
+   memset(w->slots, '\0', sizeof(w->slots));
+   memset(w->bitmap, '\0', sizeof(w->bitmap));
+   w->base       = 0;
+   w->size       = 0;
+   w->node_stack = rt_alloc_stack_new(sizeof(wnode_t), "wheel");
+   return w;
+}
+
+void wheel_free(wheel_t w)
+{
+   for (int level = 0; level < WHEEL_LEVELS; level++) {
+      for (int index = 0; index < WHEEL_SLOTS; index++) {
+         wnode_t *n = w->slots[level][index].head;
+         while (n != NULL) {
+            wnode_t *next = n->next;
+            rt_free(w->node_stack, n);
+            n = next;
+         }
+      }
+   }
+
+   rt_alloc_stack_destroy(w->node_stack);
+   free(w);
+}
+
+void *wheel_extract_min(wheel_t w)
+{
+   struct slot *s = wheel_first(w);
+   if (unlikely(s == NULL))
+      fatal_trace("wheel underflow");
+
+   wnode_t *n = s->head;
+   if ((s->head = n->next) == NULL) {
+      const int index = n->key & WHEEL_MASK;
+      wheel_unlink_all(w, 0, index);
+   }
+
+   w->base = n->key;
+   --(w->size);
+
+   void *user = n->user;
+   rt_free(w->node_stack, n);
+   return user;
+}
+
+void *wheel_min(wheel_t w)
+{
+   // Entries on level zero are already in key order but otherwise the
+   // smallest key is somewhere in the first occupied slot of the lowest
+   // occupied level: search it without cascading so the base is left
+   // at the last key extracted
+
+   int index = wheel_next_slot(w, 0, w->base & WHEEL_MASK);
+   if (index >= 0)
+      return w->slots[0][index].head->user;
+
+   for (int level = 1; level < WHEEL_LEVELS; level++) {
+      const int from = ((w->base >> (level * WHEEL_BITS)) & WHEEL_MASK) + 1;
+      if ((index = wheel_next_slot(w, level, from)) >= 0) {
+         wnode_t *min = w->slots[level][index].head;
+         for (wnode_t *n = min->next; n != NULL; n = n->next) {
+            if (n->key < min->key)
+               min = n;
+         }
+         return min->user;
+      }
+   }
+
+   fatal_trace("wheel underflow");
+}
+
+void wheel_insert(wheel_t w, uint64_t key, void *user)
+{
+   if (unlikely(key < w->base))
+      fatal_trace("wheel key %"PRIu64" is before base %"PRIu64, key, w->base);
+
+   wnode_t *n = rt_alloc(w->node_stack);
+   n->key  = key;
+   n->user = user;
+
+   wheel_link(w, n);
+   ++(w->size);
+}
+
+size_t wheel_size(wheel_t w)
+{
+   return w->size;
+}
+
+void wheel_walk(wheel_t w, wheel_walk_fn_t fn, void *context)
+{
+   for (int level = 0; level < WHEEL_LEVELS; level++) {
+      for (int index = 0; index < WHEEL_SLOTS; index++) {
+         for (wnode_t *n = w->slots[level][index].head; n; n = n->next)
+            (*fn)(n->key, n->user, context);
+      }
+   }
+}
@@ -210,6 +210,9 @@ static tree_t simp_attr_delayed_transaction(tree_t t, simp_ctx_t *ctx)
 
    tree_add_stmt(p, wait);
 
+   if (attr == TRANSACTION)
+      tree_add_attr_int(p, ident_new("transaction"), 1);
+
    imp_signal_t *imp = xmalloc(sizeof(imp_signal_t));
    imp->next    = ctx->imp_signals;
    imp->signal  = s;
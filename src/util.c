@@ -35,6 +35,7 @@
 #include <ctype.h>
 #include <assert.h>
 #include <limits.h>
+#include <time.h>
 
 #include <sys/types.h>
 #include <sys/time.h>
@@ -1092,3 +1093,12 @@ void nvc_rusage(nvc_rusage_t *ru)
 
    last = sys;
 }
+
+uint64_t get_timestamp_ns(void)
+{
+   struct timespec ts;
+   if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0)
+      fatal_errno("clock_gettime");
+
+   return (ts.tv_sec * UINT64_C(1000000000)) + ts.tv_nsec;
+}
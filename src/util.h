@@ -143,5 +143,6 @@ typedef struct {
 } nvc_rusage_t;
 
 void nvc_rusage(nvc_rusage_t *ru);
+uint64_t get_timestamp_ns(void);
 
 #endif // _UTIL_H
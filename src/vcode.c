@@ -542,6 +542,11 @@ bool vcode_var_extern(vcode_var_t var)
    return vcode_var_data(var)->is_extern;
 }
 
+bool vcode_var_const(vcode_var_t var)
+{
+   return vcode_var_data(var)->is_const;
+}
+
 bool vcode_var_use_heap(vcode_var_t var)
 {
    return vcode_var_data(var)->use_heap;
@@ -611,14 +616,16 @@ unsigned vcode_get_subkind(int op)
    assert(o->kind == VCODE_OP_SCHED_EVENT || o->kind == VCODE_OP_BOUNDS
           || o->kind == VCODE_OP_VEC_LOAD || o->kind == VCODE_OP_BIT_VEC_OP
           || o->kind == VCODE_OP_INDEX_CHECK || o->kind == VCODE_OP_BIT_SHIFT
-          || o->kind == VCODE_OP_ALLOCA || o->kind == VCODE_OP_RESUME);
+          || o->kind == VCODE_OP_ALLOCA || o->kind == VCODE_OP_RESUME
+          || o->kind == VCODE_OP_SCHED_CLOCK
+          || o->kind == VCODE_OP_SCHED_WAVEFORM);
    return o->subkind;
 }
 
 int64_t vcode_get_value(int op)
 {
    op_t *o = vcode_op_data(op);
-   assert(o->kind == VCODE_OP_CONST);
+   assert(o->kind == VCODE_OP_CONST || o->kind == VCODE_OP_DEBUG_LINE);
    return o->value;
 }
 
@@ -772,7 +779,8 @@ const char *vcode_op_string(vcode_op_t op)
       "file read", "null", "new", "null check", "deallocate", "all",
       "bit vec op", "const real", "value", "last event", "needs last value",
       "dynamic bounds", "array size", "index check", "bit shift",
-      "storage hint", "debug out", "nested pcall"
+      "storage hint", "debug out", "nested pcall", "sched clock",
+      "debug line"
    };
    if ((unsigned)op >= ARRAY_LEN(strs))
       return "???";
@@ -1345,6 +1353,8 @@ void vcode_dump(void)
                vcode_dump_reg(op->args.items[3]);
                printf(" after ");
                vcode_dump_reg(op->args.items[4]);
+               if ((int)op->subkind != VCODE_INVALID_SLOT)
+                  printf(" slot %d", (int)op->subkind);
             }
             break;
 
@@ -1776,6 +1786,31 @@ void vcode_dump(void)
                col += vcode_dump_reg(op->args.items[0]);
             }
             break;
+
+         case VCODE_OP_DEBUG_LINE:
+            {
+               color_printf("$cyan$// line %"PRIi64"$$ ", op->value);
+            }
+            break;
+
+         case VCODE_OP_SCHED_CLOCK:
+            {
+               printf("%s ", vcode_op_string(op->kind));
+               vcode_dump_reg(op->args.items[0]);
+               printf(" values ");
+               vcode_dump_reg(op->args.items[1]);
+               printf(", ");
+               vcode_dump_reg(op->args.items[2]);
+               printf(" after ");
+               vcode_dump_reg(op->args.items[3]);
+               printf(" periods ");
+               vcode_dump_reg(op->args.items[4]);
+               printf(", ");
+               vcode_dump_reg(op->args.items[5]);
+               printf(" toggle ");
+               vcode_dump_reg(op->args.items[6]);
+            }
+            break;
          }
 
          printf("\n");
@@ -3125,7 +3160,7 @@ vcode_reg_t emit_nets(vcode_signal_t sig)
 
 void emit_sched_waveform(vcode_reg_t nets, vcode_reg_t nnets,
                          vcode_reg_t values, vcode_reg_t reject,
-                         vcode_reg_t after)
+                         vcode_reg_t after, int slot)
 {
    int64_t nconst;
    if (vcode_reg_const(nnets, &nconst) && nconst == 0) {
@@ -3139,6 +3174,7 @@ void emit_sched_waveform(vcode_reg_t nets, vcode_reg_t nnets,
    vcode_add_arg(op, values);
    vcode_add_arg(op, reject);
    vcode_add_arg(op, after);
+   op->subkind = slot;
 
    VCODE_ASSERT(vcode_reg_kind(nets) == VCODE_TYPE_SIGNAL,
                 "sched_waveform target is not signal");
@@ -4026,3 +4062,31 @@ void emit_debug_out(vcode_reg_t reg)
    op_t *op = vcode_add_op(VCODE_OP_DEBUG_OUT);
    vcode_add_arg(op, reg);
 }
+
+void emit_sched_clock(vcode_reg_t nets, vcode_reg_t value0, vcode_reg_t value1,
+                      vcode_reg_t after, vcode_reg_t period0,
+                      vcode_reg_t period1, vcode_reg_t toggle, int slot)
+{
+   op_t *op = vcode_add_op(VCODE_OP_SCHED_CLOCK);
+   vcode_add_arg(op, nets);
+   vcode_add_arg(op, value0);
+   vcode_add_arg(op, value1);
+   vcode_add_arg(op, after);
+   vcode_add_arg(op, period0);
+   vcode_add_arg(op, period1);
+   vcode_add_arg(op, toggle);
+   op->subkind = slot;
+
+   VCODE_ASSERT(vcode_reg_kind(nets) == VCODE_TYPE_SIGNAL,
+                "sched_clock target is not signal");
+   VCODE_ASSERT(vcode_reg_kind(value0) == vcode_reg_kind(value1),
+                "sched_clock values must have the same type");
+   VCODE_ASSERT(vtype_eq(vcode_reg_type(toggle), vtype_bool()),
+                "sched_clock toggle flag must have bool type");
+}
+
+void emit_debug_line(int line)
+{
+   // Marks the start of the code for a statement on this source line
+   vcode_add_op(VCODE_OP_DEBUG_LINE)->value = line;
+}
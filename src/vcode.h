@@ -122,6 +122,8 @@ typedef enum {
    VCODE_OP_STORAGE_HINT,
    VCODE_OP_DEBUG_OUT,
    VCODE_OP_NESTED_PCALL,
+   VCODE_OP_SCHED_CLOCK,
+   VCODE_OP_DEBUG_LINE,
 } vcode_op_t;
 
 typedef enum {
@@ -160,6 +162,7 @@ typedef struct {
 #define VCODE_INVALID_VAR    -1
 #define VCODE_INVALID_SIGNAL -1
 #define VCODE_INVALID_TYPE   -1
+#define VCODE_INVALID_SLOT   -1
 
 vcode_type_t vtype_int(int64_t low, int64_t high);
 vcode_type_t vtype_dynamic(vcode_reg_t low, vcode_reg_t high);
@@ -256,6 +259,7 @@ int vcode_var_context(vcode_var_t var);
 ident_t vcode_var_name(vcode_var_t var);
 vcode_type_t vcode_var_type(vcode_var_t var);
 bool vcode_var_extern(vcode_var_t var);
+bool vcode_var_const(vcode_var_t var);
 bool vcode_var_use_heap(vcode_var_t var);
 
 vcode_unit_t emit_function(ident_t name, vcode_unit_t context,
@@ -320,7 +324,7 @@ void emit_return(vcode_reg_t reg);
 vcode_reg_t emit_nets(vcode_signal_t sig);
 void emit_sched_waveform(vcode_reg_t nets, vcode_reg_t nnets,
                          vcode_reg_t values, vcode_reg_t reject,
-                         vcode_reg_t after);
+                         vcode_reg_t after, int slot);
 void emit_cond(vcode_reg_t test, vcode_block_t btrue, vcode_block_t bfalse);
 vcode_reg_t emit_neg(vcode_reg_t lhs);
 vcode_reg_t emit_abs(vcode_reg_t lhs);
@@ -387,5 +391,9 @@ void emit_storage_hint(vcode_reg_t mem, vcode_reg_t length);
 void emit_debug_out(vcode_reg_t reg);
 void emit_nested_pcall(ident_t func, const vcode_reg_t *args, int nargs,
                        vcode_block_t resume_bb, int hops);
+void emit_sched_clock(vcode_reg_t nets, vcode_reg_t value0, vcode_reg_t value1,
+                      vcode_reg_t after, vcode_reg_t period0,
+                      vcode_reg_t period1, vcode_reg_t toggle, int slot);
+void emit_debug_line(int line);
 
 #endif  // _VCODE_H
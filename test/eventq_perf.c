@@ -0,0 +1,124 @@
+#include "util.h"
+#include "rt/heap.h"
+#include "rt/wheel.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <assert.h>
+#include <time.h>
+
+// Compare the binary heap and timing wheel event queues. Pass a trace
+// recorded by building the kernel with TRACE_EVENTQ set and running one
+// of the designs in test/perf, otherwise a synthetic trace with a mix of
+// clock period and random delays is used.
+
+typedef struct {
+   uint64_t key;   // Zero for extract
+} op_t;
+
+static op_t   *ops = NULL;
+static size_t  n_ops = 0;
+static size_t  max_ops = 0;
+
+static void add_op(uint64_t key)
+{
+   ARRAY_APPEND(ops, (op_t){ key }, n_ops, max_ops);
+}
+
+static void read_trace(const char *file)
+{
+   FILE *f = fopen(file, "r");
+   if (f == NULL)
+      fatal_errno("%s", file);
+
+   char line[64];
+   while (fgets(line, sizeof(line), f) != NULL) {
+      if (line[0] == '+')
+         add_op(strtoull(line + 2, NULL, 10));
+      else if (line[0] == '-')
+         add_op(0);
+   }
+
+   fclose(f);
+}
+
+static void synthetic_trace(void)
+{
+   // Keep a fixed number of events pending and advance time to that of
+   // each extracted event like the simulation kernel
+
+   static const int N = 10000000;
+   static const int PENDING = 100000;
+
+   heap_t h = heap_new(512);
+   uint64_t now = 0;
+
+   for (int i = 0; i < N; i++) {
+      uint64_t delay;
+      if (i % 2 == 0)
+         delay = 5000000 * (1 + (i % 4));
+      else
+         delay = 1 + (random() % 1000000);
+
+      const uint64_t key = ((now + delay) << 2) | (i & 3);
+      add_op(key);
+      heap_insert(h, key, (void *)(uintptr_t)key);
+
+      if (heap_size(h) > PENDING) {
+         add_op(0);
+         now = (uintptr_t)heap_extract_min(h) >> 2;
+      }
+   }
+
+   heap_free(h);
+}
+
+static double elapsed(struct timespec *start)
+{
+   struct timespec end;
+   clock_gettime(CLOCK_MONOTONIC, &end);
+   return (end.tv_sec - start->tv_sec)
+      + (end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+#define RUN_QUEUE(prefix, q) do {                                       \
+      struct timespec start;                                            \
+      clock_gettime(CLOCK_MONOTONIC, &start);                           \
+      uint64_t sum = 0;                                                 \
+      for (size_t i = 0; i < n_ops; i++) {                              \
+         if (ops[i].key != 0)                                           \
+            prefix##_insert(q, ops[i].key, (void *)(uintptr_t)ops[i].key); \
+         else                                                           \
+            sum += (uintptr_t)prefix##_extract_min(q);                  \
+      }                                                                 \
+      while (prefix##_size(q) > 0)                                      \
+         sum += (uintptr_t)prefix##_extract_min(q);                     \
+      printf("%-6s %8.3fs  checksum %"PRIx64"\n", #prefix,             \
+             elapsed(&start), sum);                                     \
+   } while (0)
+
+int main(int argc, char **argv)
+{
+   max_ops = 1024;
+   ops = xmalloc(max_ops * sizeof(op_t));
+
+   if (argc > 1)
+      read_trace(argv[1]);
+   else
+      synthetic_trace();
+
+   printf("%zu operations\n", n_ops);
+
+   heap_t h = heap_new(512);
+   RUN_QUEUE(heap, h);
+   heap_free(h);
+
+   wheel_t w = wheel_new();
+   RUN_QUEUE(wheel, w);
+   wheel_free(w);
+
+   free(ops);
+   return 0;
+}
@@ -0,0 +1,38 @@
+entity dyn_wait is
+end entity;
+
+architecture test of dyn_wait is
+
+    constant N     : integer := 256;
+    constant DEPTH : integer := 64;
+    constant ITERS : integer := 2000;
+
+begin
+
+    g: for i in 0 to N - 1 generate
+        -- The dynamic index splits mem into one group per element so
+        -- waiting on the whole signal uses the global pending list
+        signal mem   : bit_vector(0 to DEPTH - 1);
+        signal count : natural;
+    begin
+
+        writer: process is
+            variable idx : natural := i mod DEPTH;
+        begin
+            for j in 1 to ITERS loop
+                mem(idx) <= not mem(idx);
+                idx := (idx + 1) mod DEPTH;
+                wait for 1 ns;
+            end loop;
+            wait;
+        end process;
+
+        reader: process is
+        begin
+            wait on mem;
+            count <= count + 1;
+        end process;
+
+    end generate;
+
+end architecture;
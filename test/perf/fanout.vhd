@@ -0,0 +1,44 @@
+entity fanout is
+end entity;
+
+architecture test of fanout is
+
+    constant N     : integer := 4096;
+    constant ITERS : integer := 10000;
+
+    type int_vec is array (natural range <>) of integer;
+
+    signal clk   : bit := '0';
+    signal reset : bit := '1';
+    signal q     : int_vec(0 to N - 1);
+
+begin
+
+    -- A single clock and reset with a large static fanout
+
+    regs: for i in 0 to N - 1 generate
+        process (clk, reset) is
+        begin
+            if reset = '1' then
+                q(i) <= 0;
+            elsif clk'event and clk = '1' then
+                q(i) <= q(i) + 1;
+            end if;
+        end process;
+    end generate;
+
+    stim: process is
+    begin
+        wait for 1 ns;
+        reset <= '0';
+        for j in 1 to ITERS loop
+            clk <= '1';
+            wait for 1 ns;
+            clk <= '0';
+            wait for 1 ns;
+        end loop;
+        assert q(N - 1) = ITERS;
+        wait;
+    end process;
+
+end architecture;
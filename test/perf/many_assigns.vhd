@@ -0,0 +1,29 @@
+entity many_assigns is
+end entity;
+
+architecture test of many_assigns is
+
+    constant N     : integer := 200;
+    constant ITERS : integer := 100000;
+
+    type int_vec is array (natural range <>) of integer;
+
+    signal clk : bit := '0';
+    signal r   : int_vec(0 to N - 1);
+
+begin
+
+    clk <= not clk after 5 ns when now < ITERS * 10 ns;
+
+    -- The loop index splits r into one group per element so every
+    -- rising edge schedules N zero-delay transactions from one process
+    regs: process (clk) is
+    begin
+        if clk'event and clk = '1' then
+            for i in 0 to N - 1 loop
+                r(i) <= r(i) + i;
+            end loop;
+        end if;
+    end process;
+
+end architecture;
@@ -0,0 +1,39 @@
+entity many_groups is
+end entity;
+
+architecture test of many_groups is
+
+    constant N     : integer := 262144;
+    constant ITERS : integer := 200;
+
+    -- The dynamic index in the loop below splits each signal into one
+    -- group per element so every cycle updates N groups
+    type int_vec is array (natural range <>) of integer;
+
+    signal v : bit_vector(0 to N - 1);
+    signal c : int_vec(0 to N - 1);
+
+begin
+
+    writer: process is
+    begin
+        for j in 1 to ITERS loop
+            for i in 0 to N - 1 loop
+                v(i) <= not v(i);
+                c(i) <= c(i) + 1;
+            end loop;
+            wait for 1 ns;
+        end loop;
+        wait;
+    end process;
+
+    reader: process (v) is
+        variable count : natural;
+    begin
+        count := count + 1;
+        if count = ITERS + 1 then
+            report "done";
+        end if;
+    end process;
+
+end architecture;
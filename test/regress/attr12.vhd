@@ -0,0 +1,68 @@
+library ieee;
+use ieee.std_logic_1164.all;
+
+entity attr12 is
+end entity;
+
+architecture test of attr12 is
+    signal x : integer := 1;
+    signal v : std_logic_vector(7 downto 0) := X"00";
+begin
+
+    driver1: process is
+    begin
+        for i in 2 to 5 loop
+            x <= i;
+            wait for 1 ns;
+        end loop;
+        x <= 5;                         -- Transaction but no event
+        wait;
+    end process;
+
+    driver2: process is
+    begin
+        v <= X"0F";
+        wait for 1 ns;
+        v <= X"F0";
+        wait for 1 ns;
+        v <= "ZZZZZZZZ";
+        wait;
+    end process;
+
+    driver3: process is
+    begin
+        v <= "ZZZZZZZZ";
+        wait for 2 ns;
+        v <= X"AA";
+        wait;
+    end process;
+
+    check: process is
+    begin
+        wait for 500 ps;
+        assert x = 2;
+        assert x'last_value = 1;
+        assert v = X"0F";
+        assert v'last_value = X"00";
+        wait for 1 ns;
+        assert x = 3;
+        assert x'last_value = 2;
+        assert v = X"F0";
+        assert v'last_value = X"0F";
+        wait for 1 ns;
+        assert x = 4;
+        assert x'last_value = 3;
+        assert v = X"AA";
+        assert v'last_value = X"F0";
+        wait for 1 ns;
+        assert x = 5;
+        assert x'last_value = 4;
+        wait for 1 ns;
+        assert x = 5;
+        assert x'last_value = 4;
+        assert v = X"AA";
+        assert v'last_value = X"F0";
+        wait;
+    end process;
+
+end architecture;
@@ -0,0 +1,78 @@
+library ieee;
+use ieee.std_logic_1164.all;
+
+entity ckpt1 is
+end entity;
+
+architecture test of ckpt1 is
+    signal clk   : bit := '0';
+    signal count : natural;
+    signal x     : integer := 0;
+    signal r     : std_logic;
+begin
+
+    -- Run to 42 ns, save a checkpoint, and then restore it: the process
+    -- variables and the transaction scheduled for 43 ns must survive
+
+    clk <= not clk after 5 ns;
+
+    counter: process (clk) is
+        variable n : natural;
+    begin
+        if clk'event and clk = '1' then
+            n := n + 1;
+            count <= n;
+        end if;
+    end process;
+
+    -- Resolved with three drivers so the driver counts must be restored
+    -- along with the driving values
+
+    drive_a: process is
+    begin
+        r <= 'Z', '0' after 10 ns, 'Z' after 50 ns;
+        wait;
+    end process;
+
+    drive_b: process is
+    begin
+        r <= 'Z', '1' after 60 ns;
+        wait;
+    end process;
+
+    drive_c: process is
+    begin
+        r <= 'Z';
+        wait for 55 ns;
+        assert r = 'Z' report std_logic'image(r);
+        wait;
+    end process;
+
+    stim: process is
+        type int_vec is array (natural range <>) of integer;
+        variable v   : integer := 0;
+        variable mem : int_vec(0 to 1023) := (others => 7);
+    begin
+        for i in 1 to 10 loop
+            v := v + i;
+            mem(i) := v;
+            x <= v after 3 ns;
+            wait for 10 ns;
+        end loop;
+
+        assert now = 100 ns;
+        assert count = 10 report integer'image(count);
+        assert x = 55 report integer'image(x);
+        assert x'last_event = 7 ns;
+        assert r = '1' report std_logic'image(r);
+
+        -- Variables are not initialised again when restoring
+        assert mem(0) = 7;
+        assert mem(4) = 10;
+        assert mem(10) = 55;
+        assert mem(1023) = 7;
+
+        wait;
+    end process;
+
+end architecture;
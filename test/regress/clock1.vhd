@@ -0,0 +1,76 @@
+entity clock1 is
+end entity;
+
+architecture test of clock1 is
+    signal a1, a2 : bit := '0';
+    signal b1, b2 : bit := '1';
+    signal c1, c2 : boolean := false;
+    signal n      : natural;
+begin
+
+    -- Each pair of signals is driven by one process the kernel can
+    -- generate directly and one equivalent process it cannot
+
+    a1 <= not a1 after 5 ns;
+
+    a2_p: process (a2) is
+        variable dummy : natural;
+    begin
+        a2 <= not a2 after 5 ns;
+    end process;
+
+    b1_p: process is
+    begin
+        b1 <= '1';
+        wait for 3 ns;
+        b1 <= '0';
+        wait for 7 ns;
+    end process;
+
+    b2_p: process is
+        variable dummy : natural;
+    begin
+        b2 <= '1';
+        wait for 3 ns;
+        b2 <= '0';
+        wait for 7 ns;
+    end process;
+
+    c1_p: process is
+    begin
+        c1 <= not c1;
+        wait for 4 ns;
+    end process;
+
+    c2_p: process is
+        variable dummy : natural;
+    begin
+        c2 <= not c2;
+        wait for 4 ns;
+    end process;
+
+    check: process (a1, a2, b1, b2, c1, c2) is
+    begin
+        assert a1 = a2;
+        assert a1'event = a2'event;
+        assert b1 = b2;
+        assert b1'event = b2'event;
+        assert c1 = c2;
+        assert c1'event = c2'event;
+
+        if a1'event then
+            n <= n + 1;
+        end if;
+    end process;
+
+    finish: process is
+    begin
+        wait for 99 ns;
+        assert n = 19;
+        assert a1'last_event = 4 ns;
+        assert b1 = '0' and b1'last_event = 6 ns;
+        assert c1'last_event = 3 ns;
+        wait;
+    end process;
+
+end architecture;
@@ -0,0 +1,43 @@
+entity clock2 is
+end entity;
+
+architecture test of clock2 is
+    signal a : bit := '0';
+    signal b : bit := '1';
+    signal c : boolean := false;
+    signal d : bit;
+    signal n : natural;
+begin
+
+    -- Run with and without optimisation and the waveforms compared: the
+    -- kernel drives each of these clocks directly in the first case
+
+    a <= not a after 5 ns;
+
+    b_p: process is
+    begin
+        b <= '1';
+        wait for 3 ns;
+        b <= '0';
+        wait for 7 ns;
+    end process;
+
+    c_p: process is
+    begin
+        c <= not c;
+        wait for 4 ns;
+    end process;
+
+    d_p: process (d) is
+    begin
+        d <= not d after 2 ns;
+    end process;
+
+    count: process (a, b, c, d) is
+    begin
+        if a'event or b'event or c'event or d'event then
+            n <= n + 1;
+        end if;
+    end process;
+
+end architecture;
@@ -0,0 +1,106 @@
+entity driver6 is
+end entity;
+
+library ieee;
+use ieee.std_logic_1164.all;
+
+architecture test of driver6 is
+
+    type u is (A, B, C);
+
+    type uv is array (natural range <>) of u;
+
+    -- Not commutative so must not be resolved incrementally
+    function first(x : uv) return u is
+    begin
+        return x(x'left);
+    end function;
+
+    -- Commutative and associative but not idempotent
+    function any_a(x : uv) return u is
+    begin
+        for i in x'range loop
+            if x(i) = A then
+                return A;
+            end if;
+        end loop;
+        return B;
+    end function;
+
+    subtype ru is any_a u;
+    subtype fu is first u;
+
+    type ruv is array (natural range <>) of ru;
+
+    signal v : std_logic_vector(7 downto 0);
+    signal r : ruv(1 to 4) := (others => C);
+    signal f : fu := C;
+
+begin
+
+    d1: process is
+    begin
+        v <= "ZZZZZZZZ";
+        r <= (others => C);
+        f <= A;
+        wait for 1 ns;
+        v <= "1111ZZZZ";
+        r <= (A, C, C, C);
+        wait for 1 ns;
+        v <= "ZZZZZZZZ";
+        r <= (C, C, C, C);
+        wait;
+    end process;
+
+    d2: process is
+    begin
+        v <= "ZZZZZZZZ";
+        r <= (others => C);
+        f <= B;
+        wait for 1 ns;
+        v <= "0000HHHH";
+        r <= (C, A, C, C);
+        wait for 1 ns;
+        v <= "ZZZZ0000";
+        wait;
+    end process;
+
+    d3: process is
+    begin
+        v <= "ZZZZZZZZ";
+        r <= (others => C);
+        f <= C;
+        wait for 1 ns;
+        v <= "ZZZZLLLL";
+        wait for 1 ns;
+        v <= "ZZZZ1111";
+        r <= (C, C, A, C);
+        wait;
+    end process;
+
+    d4: process is
+    begin
+        v <= "ZZZZZZZZ";
+        wait for 1 ns;
+        wait for 1 ns;
+        v <= "WWWWZZZZ";
+        wait;
+    end process;
+
+    check: process is
+    begin
+        wait for 0 ns;
+        assert v = "ZZZZZZZZ";
+        assert r = (B, B, B, B);
+        assert f = A;
+        wait for 1 ns;
+        assert v = "XXXXWWWW";
+        assert r = (A, A, B, B);
+        wait for 1 ns;
+        assert v = "WWWWXXXX";
+        assert r = (B, A, A, B);
+        assert f = A;
+        wait;
+    end process;
+
+end architecture;
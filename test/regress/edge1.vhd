@@ -0,0 +1,84 @@
+library ieee;
+use ieee.std_logic_1164.all;
+
+entity edge1 is
+end entity;
+
+architecture test of edge1 is
+    signal clk                  : std_logic := 'U';
+    signal bclk                 : bit := '0';
+    signal rise1, rise2         : natural;
+    signal fall1, fall2         : natural;
+    signal bhigh1, bhigh2       : natural;
+begin
+
+    -- The first process of each pair is only woken on the matching
+    -- edge whereas the second is woken on every event
+
+    rise1_p: process (clk) is
+    begin
+        if rising_edge(clk) then
+            rise1 <= rise1 + 1;
+        end if;
+    end process;
+
+    rise2_p: process (clk) is
+    begin
+        if rising_edge(clk) then
+            rise2 <= rise2 + 1;
+        end if;
+        null;
+    end process;
+
+    fall1_p: process (clk) is
+    begin
+        if falling_edge(clk) then
+            fall1 <= fall1 + 1;
+        end if;
+    end process;
+
+    fall2_p: process (clk) is
+    begin
+        if falling_edge(clk) then
+            fall2 <= fall2 + 1;
+        end if;
+        null;
+    end process;
+
+    bhigh1_p: process (bclk) is
+    begin
+        if bclk'event and bclk = '1' then
+            bhigh1 <= bhigh1 + 1;
+        end if;
+    end process;
+
+    bhigh2_p: process (bclk) is
+    begin
+        if bclk'event and bclk = '1' then
+            bhigh2 <= bhigh2 + 1;
+        end if;
+        null;
+    end process;
+
+    stim: process is
+        type values_t is array (natural range <>) of std_logic;
+        constant values : values_t := "01HL0X1Z0HWH0";
+    begin
+        for i in values'range loop
+            clk <= values(i);
+            bclk <= not bclk;
+            wait for 1 ns;
+        end loop;
+
+        assert rise1 = rise2;
+        assert fall1 = fall2;
+        assert bhigh1 = bhigh2;
+
+        assert rise1 = 2 report integer'image(rise1);
+        assert fall1 = 2 report integer'image(fall1);
+        assert bhigh1 = 7 report integer'image(bhigh1);
+
+        wait;
+    end process;
+
+end architecture;
@@ -0,0 +1,69 @@
+entity level1 is
+end entity;
+
+architecture test of level1 is
+    signal a          : integer := 0;
+    signal b, c, d, e : integer;
+    signal x, y       : integer := 0;
+    signal clk        : bit := '0';
+    signal q          : integer;
+    signal g, h       : integer := 0;
+begin
+
+    -- Acyclic chain with reconvergent paths
+    b <= a + 1;
+    c <= b * 2;
+    d <= c + b;
+
+    -- Read by a process that uses 'EVENT so keeps normal delta timing
+    e <= d - a;
+
+    -- Combinational loop
+    x <= y + a;
+    y <= a when x < 0 else 0;
+
+    -- Two transactions on G for every change of A: the process driving
+    -- G must not be levelised as G'TRANSACTION observes each of them
+    h <= a + 1;
+    g <= h + a;
+
+    reg: process (clk) is
+    begin
+        if clk'event and clk = '1' then
+            q <= e;
+        end if;
+    end process;
+
+    stim: process is
+        variable t : bit;
+    begin
+        for i in 1 to 5 loop
+            t := g'transaction;
+            a <= i;
+            wait for 1 ns;
+            assert g'transaction = t;
+            assert g = 2 * i + 1;
+            assert b = i + 1;
+            assert c = 2 * (i + 1);
+            assert d = 3 * (i + 1);
+            assert e = 3 * (i + 1) - i;
+            assert x = i;
+            assert y = 0;
+
+            clk <= '1';
+            wait for 1 ns;
+            assert q = 3 * (i + 1) - i;
+            clk <= '0';
+        end loop;
+
+        a <= -1;
+        wait for 1 ns;
+        assert d = 0;
+        assert e = 1;
+        assert x = -2;
+        assert y = -1;
+
+        wait;
+    end process;
+
+end architecture;
@@ -0,0 +1,40 @@
+entity signal14 is
+end entity;
+
+architecture test of signal14 is
+    signal v : bit_vector(15 downto 0);
+begin
+
+    process is
+        variable i : natural := 0;
+    begin
+        -- The dynamic index splits v into one group per element so the
+        -- assignments below each span many groups
+        v(i) <= '1';
+        wait for 1 ns;
+        assert v = X"0001";
+
+        v <= X"00FF" after 2 ns;
+        v <= X"0F0F" after 1 ns;        -- Deletes the first transaction
+        wait for 1 ns;
+        assert v = X"0F0F";
+        wait for 2 ns;
+        assert v = X"0F0F";
+
+        v <= X"AAAA" after 5 ns;
+        v(3 downto 0) <= X"5" after 5 ns;
+        wait for 5 ns;
+        assert v = X"AAA5";
+
+        v <= transport X"1111" after 1 ns;
+        v <= transport X"2222" after 2 ns;
+        v(15 downto 8) <= transport X"33" after 1 ns;  -- Deletes X"22"
+        wait for 1 ns;
+        assert v = X"3311";
+        wait for 1 ns;
+        assert v = X"3322";
+
+        wait;
+    end process;
+
+end architecture;
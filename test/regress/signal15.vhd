@@ -0,0 +1,56 @@
+entity signal15 is
+end entity;
+
+architecture test of signal15 is
+    signal a, b : bit;
+    signal v    : bit_vector(0 to 7);
+    signal n, m : natural;
+begin
+
+    -- Processes must only resume once per cycle however many of the
+    -- signals in their sensitivity list change
+
+    count_ab: process (a, b) is
+        variable count : natural;
+    begin
+        count := count + 1;
+        n <= count;
+    end process;
+
+    count_v: process (v) is
+        variable count : natural;
+    begin
+        count := count + 1;
+        m <= count;
+    end process;
+
+    stim: process is
+        variable i : natural;
+    begin
+        wait for 1 ns;
+        assert n = 1 and m = 1;         -- Initial run
+
+        a <= '1';
+        b <= '1';
+        wait for 1 ns;
+        assert n = 2 report integer'image(n);
+
+        for j in 1 to 3 loop
+            for k in v'range loop
+                i := (k + j) mod v'length;  -- Split into one group per bit
+                v(i) <= not v(i);
+            end loop;
+            wait for 1 ns;
+        end loop;
+        assert m = 4 report integer'image(m);
+
+        a <= '0';
+        wait for 1 ns;
+        b <= '0';
+        wait for 1 ns;
+        assert n = 4 report integer'image(n);
+
+        wait;
+    end process;
+
+end architecture;
@@ -0,0 +1,29 @@
+entity signal16 is
+end entity;
+
+architecture test of signal16 is
+    signal s : bit;
+begin
+
+    -- The second assignment preempts the first before the process
+    -- suspends so simulation should end at 5 ns with no time step at
+    -- 10 ns
+
+    stim: process is
+    begin
+        s <= '0' after 10 ns;
+        s <= '1' after 5 ns;
+        wait;
+    end process;
+
+    check: process is
+    begin
+        wait on s;
+        assert now = 5 ns;
+        assert s = '1';
+        wait on s;
+        report "unexpected event at " & time'image(now) severity failure;
+        wait;
+    end process;
+
+end architecture;
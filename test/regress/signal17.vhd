@@ -0,0 +1,31 @@
+entity signal17 is
+end entity;
+
+architecture test of signal17 is
+    signal a, b : bit;
+begin
+
+    -- Both parts of the transaction queued for 10 ns are preempted so
+    -- simulation should end at 3 ns with no time step at 10 ns
+
+    stim: process is
+    begin
+        a <= '1' after 10 ns;
+        b <= '1' after 10 ns;
+        wait for 1 ns;
+        a <= '1' after 2 ns;
+        b <= '1' after 2 ns;
+        wait;
+    end process;
+
+    check: process is
+    begin
+        wait on a, b;
+        assert now = 3 ns;
+        assert a = '1' and b = '1';
+        wait on a, b;
+        report "unexpected event at " & time'image(now) severity failure;
+        wait;
+    end process;
+
+end architecture;
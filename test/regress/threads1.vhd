@@ -0,0 +1,40 @@
+entity threads1 is
+end entity;
+
+architecture test of threads1 is
+    constant N : integer := 64;
+
+    type int_vec is array (integer range <>) of integer;
+
+    signal clk   : bit := '0';
+    signal count : int_vec(0 to N - 1) := (others => 0);
+    signal done  : bit_vector(0 to N - 1);
+begin
+
+    clk <= not clk after 5 ns when now < 200 ns;
+
+    g: for i in 0 to N - 1 generate
+
+        process (clk) is
+        begin
+            if clk'event and clk = '1' then
+                count(i) <= count(i) + i;
+            end if;
+        end process;
+
+        done(i) <= '1' when count(i) = 20 * i else '0';
+
+    end generate;
+
+    process is
+    begin
+        wait for 300 ns;
+        for i in 0 to N - 1 loop
+            assert count(i) = 20 * i;
+            assert done(i) = '1';
+        end loop;
+        report "done";
+        wait;
+    end process;
+
+end architecture;
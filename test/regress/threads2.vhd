@@ -0,0 +1,59 @@
+entity threads2 is
+end entity;
+
+architecture test of threads2 is
+    constant N : integer := 64;
+
+    type int_vec is array (integer range <>) of integer;
+
+    -- The result size depends on the argument so it must be allocated
+    -- on the temporary stack of the thread running the process
+    function ones(n : natural) return bit_vector is
+        variable r : bit_vector(1 to n);
+    begin
+        for i in r'range loop
+            r(i) := '1';
+        end loop;
+        return r;
+    end function;
+
+    function count_ones(v : bit_vector) return natural is
+        variable n : natural := 0;
+    begin
+        for i in v'range loop
+            if v(i) = '1' then
+                n := n + 1;
+            end if;
+        end loop;
+        return n;
+    end function;
+
+    signal clk   : bit := '0';
+    signal count : int_vec(0 to N - 1) := (others => 0);
+begin
+
+    clk <= not clk after 5 ns when now < 200 ns;
+
+    g: for i in 0 to N - 1 generate
+
+        process (clk) is
+        begin
+            if clk'event and clk = '1' then
+                count(i) <= count(i) + count_ones(ones(i) & ones(1));
+            end if;
+        end process;
+
+    end generate;
+
+    process is
+    begin
+        wait for 300 ns;
+        for i in 0 to N - 1 loop
+            assert count(i) = 20 * (i + 1)
+                report integer'image(i) & " " & integer'image(count(i));
+        end loop;
+        report "done";
+        wait;
+    end process;
+
+end architecture;
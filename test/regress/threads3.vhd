@@ -0,0 +1,34 @@
+entity threads3 is
+end entity;
+
+architecture test of threads3 is
+    constant N : integer := 64;
+
+    type int_vec is array (integer range <>) of integer;
+
+    signal clk   : bit := '0';
+    signal count : int_vec(0 to N - 1) := (others => 0);
+begin
+
+    clk <= not clk after 5 ns when now < 200 ns;
+
+    g: for i in 0 to N - 1 generate
+
+        process (clk) is
+            variable x : integer;
+        begin
+            if clk'event and clk = '1' then
+                count(i) <= count(i) + 1;
+
+                -- A process running on a worker thread must stop at
+                -- the failed assertion and not reach the division
+                if i = 40 and count(i) = 3 then
+                    assert false report "stop here" severity failure;
+                    x := 100 / (count(i) - 3);
+                end if;
+            end if;
+        end process;
+
+    end generate;
+
+end architecture;
@@ -0,0 +1,34 @@
+entity threads4 is
+end entity;
+
+architecture test of threads4 is
+    constant N : integer := 64;
+
+    type int_vec is array (integer range <>) of integer;
+
+    signal clk   : bit := '0';
+    signal count : int_vec(0 to N - 1) := (others => 0);
+begin
+
+    clk <= not clk after 5 ns when now < 200 ns;
+
+    g: for i in 0 to N - 1 generate
+
+        process (clk) is
+        begin
+            if clk'event and clk = '1' then
+                count(i) <= count(i) + 1;
+
+                -- The report from the earlier process must appear
+                -- before the bounds failure raised on a worker thread
+                if i = 20 and count(i) = 3 then
+                    report "before failure";
+                elsif i = 40 and count(i) = 3 then
+                    count(count(i) + 61) <= 1;
+                end if;
+            end if;
+        end process;
+
+    end generate;
+
+end architecture;
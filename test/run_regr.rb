@@ -67,9 +67,9 @@ def analyse(t)
   run_cmd "#{nvc} #{std t} -a #{TestDir}/regress/#{t[:name]}.vhd"
 end
 
-def elaborate(t)
-  opt = '--disable-opt' unless t[:flags].member? 'opt'
-  run_cmd "#{nvc} #{std t} -e #{t[:name]} #{opt} #{native}"
+def elaborate(t, opt=t[:flags].member?('opt'))
+  disable = '--disable-opt' unless opt
+  run_cmd "#{nvc} #{std t} -e #{t[:name]} #{disable} #{native}"
 end
 
 def run(t)
@@ -77,12 +77,43 @@ def run(t)
   t[:flags].each do |f|
     cmd += " --stop-time=#{Regexp.last_match(1)}" if f =~ /stop=(.*)/
     cmd += " --load=#{BuildDir}/lib/#{t[:name]}.so" if f == 'vhpi'
+    cmd += " --threads=#{Regexp.last_match(1)}" if f =~ /threads=(.*)/
+    cmd += " --levelise" if f == 'levelise'
+    cmd += " --stats" if f == 'stats'
+    cmd += " --format=vcd --wave=#{t[:name]}.vcd" if f == 'wavecmp'
+    if f =~ /checkpoint=(.*)/ then
+      at = Regexp.last_match(1)
+      run_cmd "#{nvc} #{std t} -r --checkpoint-at=#{at} --stop-time=#{at} " +
+              "--save=#{t[:name]}.ckpt #{t[:name]}"
+      cmd += " --restore=#{t[:name]}.ckpt"
+    end
   end
   cmd += " #{t[:name]}"
   run_cmd cmd, t[:flags].member?('fail')
 end
 
+def vcd_changes(file)
+  # Skip the header as it contains the date
+  lines = File.readlines(file)
+  lines.drop_while { |l| not l.include? '$enddefinitions' }
+end
+
+def wave_compare(t)
+  # Waveform must be the same when elaborated without optimisation
+  File.rename "#{t[:name]}.vcd", "#{t[:name]}.opt.vcd"
+  elaborate t, false
+  run t
+  unless vcd_changes("#{t[:name]}.vcd") == vcd_changes("#{t[:name]}.opt.vcd")
+    puts "failed (waveform differs without optimisation)".red
+    return false
+  end
+  true
+end
+
 def check(t)
+  if t[:flags].member? 'wavecmp' then
+    return false unless wave_compare t
+  end
   if t[:flags].member? 'gold' then
     fname = TestDir + "regress/gold/#{t[:name]}.txt"
     out_lines = []
@@ -0,0 +1,176 @@
+#include "rt/itree.h"
+
+#include <check.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+static itree_t t = NULL;
+
+static void setup(void)
+{
+   t = itree_new();
+}
+
+static void teardown(void)
+{
+   itree_free(t);
+   t = NULL;
+}
+
+typedef struct {
+   uintptr_t users[512];
+   int       count;
+   uint32_t  last_low;
+} collect_t;
+
+static void collect_fn(uint32_t low, uint32_t high, void *user, void *context)
+{
+   collect_t *c = context;
+
+   fail_if(low < c->last_low);
+   fail_unless(c->count < 512);
+
+   c->users[(c->count)++] = (uintptr_t)user;
+   c->last_low = low;
+}
+
+START_TEST(test_basic)
+{
+   itree_insert(t, 0, 9, (void*)1);
+   itree_insert(t, 10, 19, (void*)2);
+   itree_insert(t, 5, 14, (void*)3);
+   itree_insert(t, 30, 30, (void*)4);
+
+   fail_unless(itree_size(t) == 4);
+
+   collect_t c = { .count = 0 };
+   itree_extract(t, 12, 12, collect_fn, &c);
+
+   fail_unless(c.count == 2);
+   fail_unless(c.users[0] == 3);
+   fail_unless(c.users[1] == 2);
+   fail_unless(itree_size(t) == 2);
+
+   c.count = c.last_low = 0;
+   itree_extract(t, 20, 29, collect_fn, &c);
+   fail_unless(c.count == 0);
+
+   c.count = c.last_low = 0;
+   itree_extract(t, 0, 100, collect_fn, &c);
+   fail_unless(c.count == 2);
+   fail_unless(c.users[0] == 1);
+   fail_unless(c.users[1] == 4);
+   fail_unless(itree_size(t) == 0);
+}
+END_TEST
+
+START_TEST(test_order)
+{
+   // Intervals with the same low end come out in insertion order
+   for (uintptr_t i = 1; i <= 10; i++)
+      itree_insert(t, 50, 50 + i, (void*)i);
+
+   collect_t c = { .count = 0 };
+   itree_walk(t, collect_fn, &c);
+   fail_unless(c.count == 10);
+
+   c.count = c.last_low = 0;
+   itree_extract(t, 55, 55, collect_fn, &c);
+   fail_unless(c.count == 6);
+   for (int i = 0; i < 6; i++)
+      fail_unless(c.users[i] == 5 + i);
+}
+END_TEST
+
+START_TEST(test_remove)
+{
+   inode_t *a = itree_insert(t, 1, 5, (void*)1);
+   inode_t *b = itree_insert(t, 1, 5, (void*)2);
+   itree_insert(t, 3, 8, (void*)3);
+
+   itree_remove(t, b);
+   fail_unless(itree_size(t) == 2);
+
+   itree_remove(t, a);
+   fail_unless(itree_size(t) == 1);
+
+   collect_t c = { .count = 0 };
+   itree_extract(t, 0, 10, collect_fn, &c);
+   fail_unless(c.count == 1);
+   fail_unless(c.users[0] == 3);
+}
+END_TEST
+
+START_TEST(test_rand)
+{
+   // Compare against a brute force search over random intervals
+   static const int N = 512;
+   uint32_t low[N], high[N];
+   bool live[N];
+   inode_t *nodes[N];
+
+   for (int i = 0; i < N; i++) {
+      low[i]   = random() % 10000;
+      high[i]  = low[i] + random() % 200;
+      live[i]  = true;
+      nodes[i] = itree_insert(t, low[i], high[i], (void*)(uintptr_t)i);
+   }
+
+   for (int i = 0; i < N; i += 7) {
+      itree_remove(t, nodes[i]);
+      live[i] = false;
+   }
+
+   size_t size = itree_size(t);
+
+   for (int k = 0; k < 200; k++) {
+      const uint32_t x = random() % 10000;
+      const uint32_t y = x + random() % 20;
+
+      int expect = 0;
+      for (int i = 0; i < N; i++) {
+         if (live[i] && (low[i] <= y) && (x <= high[i])) {
+            live[i] = false;
+            expect++;
+         }
+      }
+
+      collect_t c = { .count = 0 };
+      itree_extract(t, x, y, collect_fn, &c);
+      fail_unless(c.count == expect);
+      for (int i = 0; i < c.count; i++) {
+         const uintptr_t u = c.users[i];
+         fail_unless((low[u] <= y) && (x <= high[u]));
+      }
+
+      size -= expect;
+      fail_unless(itree_size(t) == size);
+   }
+}
+END_TEST
+
+int main(void)
+{
+   srandom((unsigned)time(NULL));
+
+   Suite *s = suite_create("itree");
+
+   TCase *tc_core = tcase_create("Core");
+   tcase_add_checked_fixture(tc_core, setup, teardown);
+   tcase_add_test(tc_core, test_basic);
+   tcase_add_test(tc_core, test_order);
+   tcase_add_test(tc_core, test_remove);
+   tcase_add_test(tc_core, test_rand);
+   suite_add_tcase(s, tc_core);
+
+   SRunner *sr = srunner_create(s);
+   srunner_run_all(sr, CK_NORMAL);
+
+   int nfail = srunner_ntests_failed(sr);
+
+   srunner_free(sr);
+
+   return nfail == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
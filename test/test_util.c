@@ -42,6 +42,8 @@ static void setup(void)
    lib_set_work(lib_tmp());
    opt_set_int("bootstrap", 0);
    opt_set_int("cover", 0);
+   opt_set_int("line-table", 0);
+   opt_set_int("restorable", 0);
    opt_set_int("unit-test", 1);
    opt_set_int("prefer-explicit", 0);
    opt_set_str("dump-vcode", NULL);
@@ -0,0 +1,228 @@
+#include "rt/wheel.h"
+
+#include <check.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+static wheel_t w = NULL;
+
+static void setup(void)
+{
+   w = wheel_new();
+}
+
+static void teardown(void)
+{
+   wheel_free(w);
+   w = NULL;
+}
+
+static int magnitude_compar(const void *a, const void *b)
+{
+   const uintptr_t x = *(const uintptr_t*)a;
+   const uintptr_t y = *(const uintptr_t*)b;
+   return (x > y) - (x < y);
+}
+
+typedef struct {
+   uintptr_t keys[8];
+   int       count;
+} walk_ctx_t;
+
+static void walk_fn(uint64_t key, void *user, void *context)
+{
+   walk_ctx_t *ctx = context;
+
+   fail_if(key != (uintptr_t)user);
+   fail_if(ctx->count == 8);
+
+   ctx->keys[(ctx->count)++] = key;
+}
+
+START_TEST(test_basic)
+{
+   wheel_insert(w, 5, (void*)5);
+   wheel_insert(w, 2, (void*)2);
+   wheel_insert(w, 62, (void*)62);
+   wheel_insert(w, 1000000, (void*)1000000);
+
+   fail_unless(wheel_size(w) == 4);
+
+   fail_unless(wheel_min(w) == (void*)2);
+
+   fail_unless(wheel_extract_min(w) == (void*)2);
+   fail_unless(wheel_extract_min(w) == (void*)5);
+   fail_unless(wheel_extract_min(w) == (void*)62);
+   fail_unless(wheel_extract_min(w) == (void*)1000000);
+
+   fail_unless(wheel_size(w) == 0);
+}
+END_TEST
+
+START_TEST(test_walk)
+{
+   wheel_insert(w, 5, (void*)5);
+   wheel_insert(w, 2, (void*)2);
+   wheel_insert(w, 62, (void*)62);
+   wheel_insert(w, 1000000, (void*)1000000);
+
+   // Entries are visited in no particular order
+   walk_ctx_t ctx = { .count = 0 };
+   wheel_walk(w, walk_fn, &ctx);
+
+   fail_unless(ctx.count == 4);
+
+   qsort(ctx.keys, ctx.count, sizeof(uintptr_t), magnitude_compar);
+
+   fail_unless(ctx.keys[0] == 2);
+   fail_unless(ctx.keys[1] == 5);
+   fail_unless(ctx.keys[2] == 62);
+   fail_unless(ctx.keys[3] == 1000000);
+}
+END_TEST
+
+START_TEST(test_rand)
+{
+   static const int N = 1024;
+   uintptr_t keys[N];
+
+   for (int i = 0; i < N; i++) {
+      keys[i] = random();
+      wheel_insert(w, keys[i], (void*)keys[i]);
+   }
+
+   qsort(keys, N, sizeof(uintptr_t), magnitude_compar);
+
+   for (int i = 0; i < N; i++)
+      fail_unless(wheel_extract_min(w) == (void*)keys[i]);
+}
+END_TEST
+
+START_TEST(test_fifo)
+{
+   // Entries with equal keys come out in insertion order
+   wheel_insert(w, 100, (void*)1);
+   wheel_insert(w, 100, (void*)2);
+   wheel_insert(w, 50, (void*)3);
+   wheel_insert(w, 100, (void*)4);
+
+   fail_unless(wheel_extract_min(w) == (void*)3);
+   fail_unless(wheel_extract_min(w) == (void*)1);
+   fail_unless(wheel_extract_min(w) == (void*)2);
+   fail_unless(wheel_extract_min(w) == (void*)4);
+}
+END_TEST
+
+START_TEST(test_interleave)
+{
+   // Simulate a clock with a fixed period and random other events
+   static const int N = 10000;
+   uint64_t now = 0;
+   size_t size = 0;
+
+   for (int i = 0; i < N; i++) {
+      const uint64_t delay = (i % 3 == 0) ? 5000000 : 1 + (random() % 100000);
+      wheel_insert(w, now + delay, (void*)(uintptr_t)(now + delay));
+      size++;
+
+      if (i % 2 == 0) {
+         const uint64_t next = (uintptr_t)wheel_extract_min(w);
+         fail_if(next < now);
+         now = next;
+         size--;
+      }
+
+      fail_unless(wheel_size(w) == size);
+   }
+
+   while (wheel_size(w) > 0) {
+      const uint64_t next = (uintptr_t)wheel_extract_min(w);
+      fail_if(next < now);
+      now = next;
+   }
+}
+END_TEST
+
+START_TEST(test_peek)
+{
+   // Peeking must not stop a smaller key being inserted afterwards
+   wheel_insert(w, 0, (void*)1);
+   wheel_insert(w, 5000000, (void*)2);
+
+   fail_unless(wheel_extract_min(w) == (void*)1);
+   fail_unless(wheel_min(w) == (void*)2);
+
+   wheel_insert(w, 1000000, (void*)3);
+   fail_unless(wheel_min(w) == (void*)3);
+
+   wheel_insert(w, 5000000, (void*)4);
+   wheel_insert(w, 1000000, (void*)5);
+
+   fail_unless(wheel_extract_min(w) == (void*)3);
+   fail_unless(wheel_extract_min(w) == (void*)5);
+   fail_unless(wheel_min(w) == (void*)2);
+   fail_unless(wheel_extract_min(w) == (void*)2);
+   fail_unless(wheel_extract_min(w) == (void*)4);
+   fail_unless(wheel_size(w) == 0);
+}
+END_TEST
+
+START_TEST(test_peek_interleave)
+{
+   // Each peek returns what the next extract will and later inserts
+   // may fall anywhere after the last key extracted
+   static const int N = 10000;
+   uint64_t now = 0;
+
+   for (int i = 0; i < N; i++) {
+      const uint64_t key = now + (random() % (UINT64_C(1) << (random() % 40)));
+      wheel_insert(w, key, (void*)(uintptr_t)key);
+
+      if (i % 3 == 0) {
+         void *peek = wheel_min(w);
+         fail_unless((uintptr_t)peek >= now);
+
+         if (i % 2 == 0) {
+            fail_unless(wheel_extract_min(w) == peek);
+            now = (uintptr_t)peek;
+         }
+      }
+   }
+
+   while (wheel_size(w) > 0) {
+      void *peek = wheel_min(w);
+      fail_unless(wheel_extract_min(w) == peek);
+      fail_if((uintptr_t)peek < now);
+      now = (uintptr_t)peek;
+   }
+}
+END_TEST
+
+int main(void)
+{
+   srandom((unsigned)time(NULL));
+
+   Suite *s = suite_create("wheel");
+
+   TCase *tc_core = tcase_create("Core");
+   tcase_add_checked_fixture(tc_core, setup, teardown);
+   tcase_add_test(tc_core, test_basic);
+   tcase_add_test(tc_core, test_rand);
+   tcase_add_test(tc_core, test_walk);
+   tcase_add_test(tc_core, test_fifo);
+   tcase_add_test(tc_core, test_interleave);
+   tcase_add_test(tc_core, test_peek);
+   tcase_add_test(tc_core, test_peek_interleave);
+   suite_add_tcase(s, tc_core);
+
+   SRunner *sr = srunner_create(s);
+   srunner_run_all(sr, CK_NORMAL);
+
+   int nfail = srunner_ntests_failed(sr);
+
+   srunner_free(sr);
+
+   return nfail == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}